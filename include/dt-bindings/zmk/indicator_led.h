@@ -0,0 +1,40 @@
+/*
+ * Palette colors of the indicator LED widget, for use in devicetree.
+ * Must stay in sync with LED_PALETTE in leds.c (checked at build time).
+ */
+
+#pragma once
+
+#define INDICATOR_LED_COLOR_OFF 0
+#define INDICATOR_LED_COLOR_RED 1
+#define INDICATOR_LED_COLOR_GREEN 2
+#define INDICATOR_LED_COLOR_BLUE 3
+#define INDICATOR_LED_COLOR_YELLOW 4
+#define INDICATOR_LED_COLOR_MAGENTA 5
+#define INDICATOR_LED_COLOR_CYAN 6
+#define INDICATOR_LED_COLOR_WHITE 7
+
+/*
+ * Blink pattern bytecode, one byte per cell of a pattern's steps property.
+ *
+ * INDICATOR_LED_MS(ms): hold the current level for ms (10 to 1910, in 10 ms
+ * units), then toggle between on and off. Patterns start on.
+ * INDICATOR_LED_SET_COLOR(c): use palette color c while on, and turn on.
+ * INDICATOR_LED_REQUEST_COLOR: go back to the color of the indication, and turn on.
+ * INDICATOR_LED_FADE: crossfade linearly to the level of the next hold instead of
+ * switching. INDICATOR_LED_EASE_IN/_OUT/_IN_OUT do the same along an easing curve.
+ * INDICATOR_LED_LOOP(n): play the whole pattern n more times (1 to 15), starting
+ * over on and in the color of the indication. Only one LOOP is allowed, as the
+ * last instruction.
+ *
+ * A pattern has at most 64 instructions and must end off: the holds after its
+ * last color instruction (or all of them, if it has none) must be even in number.
+ */
+#define INDICATOR_LED_MS(ms) ((ms) / 10)
+#define INDICATOR_LED_SET_COLOR(c) (0xC0 + (c))
+#define INDICATOR_LED_REQUEST_COLOR 0xDF
+#define INDICATOR_LED_FADE 0xE0
+#define INDICATOR_LED_EASE_IN 0xE1
+#define INDICATOR_LED_EASE_OUT 0xE2
+#define INDICATOR_LED_EASE_IN_OUT 0xE3
+#define INDICATOR_LED_LOOP(n) (0xF0 + (n))
@@ -0,0 +1,27 @@
+/*
+ * Deadline arithmetic of the indicator LED blink engine, shared by leds.c and the
+ * host test in tests/blink. Pure integer code with no kernel dependencies.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Buckets of the step lateness histogram: 0, 1, 2-3, 4-7, 8-15, 16+ ms
+#define BLINK_LATE_BUCKETS 6
+
+// Moves the deadline on to the next step, delay_ms after the deadline of the
+// current one rather than after the wakeup that ran it, so wakeup latency never
+// adds up over a sequence. Returns the new deadline, which may already be past
+// after a late wakeup; the step then runs at once and the sequence catches up.
+static inline int64_t blink_deadline_advance(int64_t *deadline_ms, uint32_t delay_ms) {
+    *deadline_ms += delay_ms;
+    return *deadline_ms;
+}
+
+// Histogram bucket of a step that ran late_ms after its deadline
+static inline uint8_t blink_late_bucket(uint32_t late_ms) {
+    uint8_t bucket = late_ms == 0 ? 0 : 32 - __builtin_clz(late_ms);
+
+    return bucket < BLINK_LATE_BUCKETS - 1 ? bucket : BLINK_LATE_BUCKETS - 1;
+}
@@ -0,0 +1,78 @@
+/*
+ * HSL to RGB conversion of the indicator LED widget, shared by leds.c and the
+ * host test in tests/hsl. Include after the definition of struct led_rgb.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// HSL to RGB conversion, done entirely in integer constant expressions so that
+// every color used by the widget is resolved at build time. All terms share the
+// denominator 1200000 (100 * 100 for s/l, 60 per hue sextant, 2 for c/2).
+#define HSL_ABS(x) ((x) < 0 ? -(x) : (x))
+#define HSL_SEXTANT(h) ((h) >= 300 ? 5 : (h) / 60)
+#define HSL_C(s, l) ((100 - HSL_ABS(2 * (l) - 100)) * (s) * 120)
+#define HSL_X(h, s, l) ((100 - HSL_ABS(2 * (l) - 100)) * (s) * 2 * (60 - HSL_ABS((h) % 120 - 60)))
+#define HSL_M(s, l) ((l) * 12000 - HSL_C(s, l) / 2)
+#define HSL_OUT(v, s, l) ((uint8_t)(((v) + HSL_M(s, l)) * 255 / 1200000))
+
+#define HSL_R(h, s, l) HSL_OUT( \
+    (HSL_SEXTANT(h) == 0 || HSL_SEXTANT(h) == 5) ? HSL_C(s, l) : \
+    (HSL_SEXTANT(h) == 1 || HSL_SEXTANT(h) == 4) ? HSL_X(h, s, l) : 0, s, l)
+#define HSL_G(h, s, l) HSL_OUT( \
+    (HSL_SEXTANT(h) == 1 || HSL_SEXTANT(h) == 2) ? HSL_C(s, l) : \
+    (HSL_SEXTANT(h) == 0 || HSL_SEXTANT(h) == 3) ? HSL_X(h, s, l) : 0, s, l)
+#define HSL_B(h, s, l) HSL_OUT( \
+    (HSL_SEXTANT(h) == 3 || HSL_SEXTANT(h) == 4) ? HSL_C(s, l) : \
+    (HSL_SEXTANT(h) == 2 || HSL_SEXTANT(h) == 5) ? HSL_X(h, s, l) : 0, s, l)
+
+// Runtime HSL to RGB conversion for colors that are actually computed on the fly
+// (fades, gradients, hue rotation). Same fixed-point formula as the macros above,
+// so no FPU or libm is needed and the result stays within 1 LSB of the float
+// reference. The hue wraps around, saturation and lightness are in percent.
+static inline struct led_rgb hsl_to_rgb(int h, int s, int l) {
+    h %= 360;
+    if (h < 0) {
+        h += 360;
+    }
+
+    int32_t c = HSL_C(s, l);
+    int32_t x = HSL_X(h, s, l);
+    int32_t r_temp, g_temp, b_temp;
+
+    switch (h / 60) {
+        case 0: r_temp = c; g_temp = x; b_temp = 0; break;
+        case 1: r_temp = x; g_temp = c; b_temp = 0; break;
+        case 2: r_temp = 0; g_temp = c; b_temp = x; break;
+        case 3: r_temp = 0; g_temp = x; b_temp = c; break;
+        case 4: r_temp = x; g_temp = 0; b_temp = c; break;
+        default: r_temp = c; g_temp = 0; b_temp = x; break;
+    }
+
+    struct led_rgb result = {
+        .r = HSL_OUT(r_temp, s, l),
+        .g = HSL_OUT(g_temp, s, l),
+        .b = HSL_OUT(b_temp, s, l)
+    };
+    return result;
+}
+
+// Float reference of the conversion above (the original runtime hsl_to_rgb()),
+// evaluated by the compiler to check the palette at build time, and by
+// tests/hsl on the host.
+#define HSL_REF_HUE6(h) ((h) / 360.0f * 6.0f)
+#define HSL_REF_C(s, l) ((1.0f - HSL_ABS(2.0f * ((l) / 100.0f) - 1.0f)) * ((s) / 100.0f))
+#define HSL_REF_X(h, s, l) (HSL_REF_C(s, l) * (1.0f - HSL_ABS( \
+    HSL_REF_HUE6(h) - 2.0f * (int)(HSL_REF_HUE6(h) / 2.0f) - 1.0f)))
+#define HSL_REF_OUT(v, s, l) ((uint8_t)(((v) + ((l) / 100.0f - HSL_REF_C(s, l) / 2.0f)) * 255))
+
+#define HSL_REF_R(h, s, l) HSL_REF_OUT( \
+    HSL_REF_HUE6(h) < 1.0f ? HSL_REF_C(s, l) : HSL_REF_HUE6(h) < 2.0f ? HSL_REF_X(h, s, l) : \
+    HSL_REF_HUE6(h) < 4.0f ? 0.0f : HSL_REF_HUE6(h) < 5.0f ? HSL_REF_X(h, s, l) : HSL_REF_C(s, l), s, l)
+#define HSL_REF_G(h, s, l) HSL_REF_OUT( \
+    HSL_REF_HUE6(h) < 1.0f ? HSL_REF_X(h, s, l) : HSL_REF_HUE6(h) < 3.0f ? HSL_REF_C(s, l) : \
+    HSL_REF_HUE6(h) < 4.0f ? HSL_REF_X(h, s, l) : 0.0f, s, l)
+#define HSL_REF_B(h, s, l) HSL_REF_OUT( \
+    HSL_REF_HUE6(h) < 2.0f ? 0.0f : HSL_REF_HUE6(h) < 3.0f ? HSL_REF_X(h, s, l) : \
+    HSL_REF_HUE6(h) < 5.0f ? HSL_REF_C(s, l) : HSL_REF_X(h, s, l), s, l)
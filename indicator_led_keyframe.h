@@ -0,0 +1,142 @@
+/*
+ * Keyframe transitions of the indicator LED blink engine, shared by leds.c and the
+ * host test in tests/blink. Pure integer code with no kernel dependencies. Include
+ * after the definition of struct led_rgb.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Easing curves of keyframe transitions, as lookup tables of eased progress (0..255)
+// over EASE_LUT_SEGMENTS equal time segments, generated at build time
+enum blink_ease {
+    EASE_STEP,      // switch at the start of the keyframe
+    EASE_LINEAR,
+    EASE_IN,        // quadratic
+    EASE_OUT,       // quadratic
+    EASE_IN_OUT,    // smoothstep
+    EASE_COUNT
+};
+
+#define EASE_LUT_SEGMENTS 32
+#define EASE_LINEAR_AT(i) ((i) * 255 / EASE_LUT_SEGMENTS)
+#define EASE_IN_AT(i) ((i) * (i) * 255 / (EASE_LUT_SEGMENTS * EASE_LUT_SEGMENTS))
+#define EASE_OUT_AT(i) \
+    (255 - (EASE_LUT_SEGMENTS - (i)) * (EASE_LUT_SEGMENTS - (i)) * 255 / \
+               (EASE_LUT_SEGMENTS * EASE_LUT_SEGMENTS))
+#define EASE_IN_OUT_AT(i) \
+    ((i) * (i) * (3 * EASE_LUT_SEGMENTS - 2 * (i)) * 255 / \
+     (EASE_LUT_SEGMENTS * EASE_LUT_SEGMENTS * EASE_LUT_SEGMENTS))
+
+// One row per curve, EASE_LUT_SEGMENTS + 1 entries
+#define EASE_LUT_ROW(F) \
+    F(0), F(1), F(2), F(3), F(4), F(5), F(6), F(7), F(8), F(9), F(10), F(11), F(12), \
+    F(13), F(14), F(15), F(16), F(17), F(18), F(19), F(20), F(21), F(22), F(23), F(24), \
+    F(25), F(26), F(27), F(28), F(29), F(30), F(31), F(32)
+
+static const uint8_t ease_lut[EASE_COUNT][EASE_LUT_SEGMENTS + 1] = {
+    [EASE_LINEAR] = {EASE_LUT_ROW(EASE_LINEAR_AT)},
+    [EASE_IN] = {EASE_LUT_ROW(EASE_IN_AT)},
+    [EASE_OUT] = {EASE_LUT_ROW(EASE_OUT_AT)},
+    [EASE_IN_OUT] = {EASE_LUT_ROW(EASE_IN_OUT_AT)},
+};
+
+// One step of a pattern: move from one color to another over a duration, along an
+// easing curve. The eased progress advances by a DDA in 1/256 LUT segment units, so
+// a frame costs additions, one table lookup and a multiply per channel. Frames are
+// computed ahead and the engine only wakes up when the output actually changes.
+struct blink_keyframe {
+    struct led_rgb from;
+    struct led_rgb to;
+    struct led_rgb next;    // next frame that differs from the one shown
+    bool active;
+    uint8_t ease;
+    uint16_t remaining_ms;  // transition time left after the next frame
+    uint16_t frame_ms;      // frame period
+
+    uint16_t phase;         // progress in 1/256 LUT segments
+    uint16_t phase_step;    // whole part of the progress per frame
+    uint16_t phase_rem;     // fractional part of the progress per frame, in 1/duration
+    uint16_t phase_err;     // DDA error accumulator
+    uint16_t duration_ms;
+};
+
+static inline uint8_t blink_mix(uint8_t from, uint8_t to, uint16_t eased) {
+    return from + ((((int32_t)to - from) * eased) >> 8);
+}
+
+static inline bool led_rgb_equal(struct led_rgb a, struct led_rgb b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+// Advances the transition in progress, frame by frame, to the next frame whose
+// output differs from shown. Returns the time until that frame, and adds the frames
+// skipped on the way to *slept.
+static inline uint32_t blink_keyframe_advance(struct blink_keyframe *kf, struct led_rgb shown,
+                                              uint32_t *slept) {
+    const uint8_t *lut = ease_lut[kf->ease];
+    uint32_t elapsed_ms = 0;
+
+    for (;;) {
+        uint16_t frame_ms = kf->remaining_ms < kf->frame_ms ? kf->remaining_ms : kf->frame_ms;
+
+        kf->remaining_ms -= frame_ms;
+        elapsed_ms += frame_ms;
+        if (kf->remaining_ms == 0) {
+            kf->next = kf->to;
+            break;
+        }
+
+        kf->phase += kf->phase_step;
+        kf->phase_err += kf->phase_rem;
+        if (kf->phase_err >= kf->duration_ms) {
+            kf->phase_err -= kf->duration_ms;
+            kf->phase++;
+        }
+
+        // interpolate between LUT entries, then scale 0..255 to 0..256
+        uint8_t seg = kf->phase >> 8;
+        uint16_t eased = lut[seg] + (((lut[seg + 1] - lut[seg]) * (kf->phase & 0xff)) >> 8);
+        eased += eased >> 7;
+
+        kf->next = (struct led_rgb){
+            .r = blink_mix(kf->from.r, kf->to.r, eased),
+            .g = blink_mix(kf->from.g, kf->to.g, eased),
+            .b = blink_mix(kf->from.b, kf->to.b, eased),
+        };
+        if (!led_rgb_equal(kf->next, shown)) {
+            break;
+        }
+        (*slept)++;
+    }
+
+    return elapsed_ms;
+}
+
+// Sets up a transition from the frame shown to target over duration_ms. Returns false
+// for a plain switch (EASE_STEP, or no longer than a frame), which the caller shows
+// at once; otherwise blink_keyframe_advance() yields the first frame.
+static inline bool blink_keyframe_start(struct blink_keyframe *kf, struct led_rgb shown,
+                                        struct led_rgb target, uint16_t duration_ms,
+                                        uint8_t ease, uint16_t frame_ms) {
+    uint32_t phase_per_frame = (uint32_t)EASE_LUT_SEGMENTS * 256 * frame_ms;
+
+    if (ease == EASE_STEP || duration_ms <= frame_ms) {
+        return false;
+    }
+
+    kf->from = shown;
+    kf->to = target;
+    kf->active = true;
+    kf->ease = ease;
+    kf->remaining_ms = duration_ms;
+    kf->frame_ms = frame_ms;
+    kf->duration_ms = duration_ms;
+    kf->phase = 0;
+    kf->phase_step = phase_per_frame / duration_ms;
+    kf->phase_rem = phase_per_frame % duration_ms;
+    kf->phase_err = 0;
+    return true;
+}
@@ -2,9 +2,10 @@
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/led.h>
 #include <zephyr/drivers/led_strip.h>
+#include <zephyr/drivers/regulator.h>
 #include <zephyr/kernel.h>
 #include <zephyr/init.h>
-#include <math.h>
+#include <zephyr/pm/device_runtime.h>
 
 #include <zmk/ble.h>
 #include <zmk/endpoints.h>
@@ -15,40 +16,21 @@
 #include <zmk/events/split_peripheral_status_changed.h>
 #include <zmk/events/battery_state_changed.h>
 #include <zmk/events/layer_state_changed.h>
+#include <zmk/events/activity_state_changed.h>
 
 #include <zephyr/logging/log.h>
 
-#define LENGTH(x)  (sizeof(x) / sizeof((x)[0]))
-#define SET_BLINK_SEQUENCE(seq) \
-do { \
-    blink.sequence = seq; \
-    blink.sequence_len = LENGTH(seq); \
-} while(0)
-
-#define BLINK_STRUCT(seq, num_repeats, led_color) \
-    (struct blink_item) { \
-        .sequence = seq, \
-        .sequence_len = LENGTH(seq), \
-        .n_repeats = num_repeats, \
-        .color = led_color \
-    }
-
-static const uint16_t CONFIG_INDICATOR_LED_LAYER_PATTERN[] = {80, 120};
-static const uint16_t CONFIG_INDICATOR_LED_BATTERY_CRITICAL_PATTERN[] = {40, 40};
-static const uint16_t CONFIG_INDICATOR_LED_BATTERY_HIGH_PATTERN[] = {500, 500};
-static const uint16_t CONFIG_INDICATOR_LED_BATTERY_LOW_PATTERN[] = {100, 100};
-// When connected, more on than off
-static const uint16_t CONFIG_INDICATOR_LED_BLE_PROFILE_CONNECTED_PATTERN[] = {1000, 100};
-// When open/unpaired, tiny blips.
-static const uint16_t CONFIG_INDICATOR_LED_BLE_PROFILE_OPEN_PATTERN[] = {80, 80};
-// When unconnected and searching, more off than on
-static const uint16_t CONFIG_INDICATOR_LED_PROFILE_UNCONNECTED_PATTERN[] = {200, 800};
-static const uint16_t STAY_ON[] = {10};
+#include <dt-bindings/zmk/indicator_led.h>
 
+#include "indicator_led_deadline.h"
+#include "indicator_led_hsl.h"
+#include "indicator_led_keyframe.h"
 
+#define LENGTH(x)  (sizeof(x) / sizeof((x)[0]))
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 #define LED_STRIP_NODE_ID DT_ALIAS(led_strip)
+#define INDICATOR_LED_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(zmk_indicator_led)
 
 // WS2812/SK6812 LED strip device
 static const struct device *led_strip = DEVICE_DT_GET(LED_STRIP_NODE_ID);
@@ -56,168 +38,1202 @@ static const struct device *led_strip = DEVICE_DT_GET(LED_STRIP_NODE_ID);
 BUILD_ASSERT(DT_NODE_EXISTS(DT_ALIAS(led_strip)),
              "An alias for led-strip is not found for SK6812 LED");
 
-// HSL to RGB conversion function
-static struct led_rgb hsl_to_rgb(int h, int s, int l) {
-    float hue = h / 360.0f;
-    float sat = s / 100.0f;
-    float light = l / 100.0f;
-    
-    float c = (1.0f - fabsf(2.0f * light - 1.0f)) * sat;
-    float x = c * (1.0f - fabsf(fmodf(hue * 6.0f, 2.0f) - 1.0f));
-    float m = light - c / 2.0f;
-    
-    float r_temp, g_temp, b_temp;
-    
-    if (hue < 1.0f/6.0f) {
-        r_temp = c; g_temp = x; b_temp = 0;
-    } else if (hue < 2.0f/6.0f) {
-        r_temp = x; g_temp = c; b_temp = 0;
-    } else if (hue < 3.0f/6.0f) {
-        r_temp = 0; g_temp = c; b_temp = x;
-    } else if (hue < 4.0f/6.0f) {
-        r_temp = 0; g_temp = x; b_temp = c;
-    } else if (hue < 5.0f/6.0f) {
-        r_temp = x; g_temp = 0; b_temp = c;
-    } else {
-        r_temp = c; g_temp = 0; b_temp = x;
-    }
-    
-    struct led_rgb result = {
-        .r = (uint8_t)((r_temp + m) * 255),
-        .g = (uint8_t)((g_temp + m) * 255),
-        .b = (uint8_t)((b_temp + m) * 255)
-    };
-    return result;
-}
-
 // Direct HSL color definitions (matching dya-dash values)
-#define HSL(h, s, l) hsl_to_rgb(h, s, l)
-
-// Color definitions using HSL values like dya-dash
-#define COLOR_RED     HSL(0, 100, 50)    // Red
-#define COLOR_GREEN   HSL(120, 100, 50)  // Green  
-#define COLOR_BLUE    HSL(240, 100, 50)  // Blue
-#define COLOR_YELLOW  HSL(60, 100, 50)   // Yellow
-#define COLOR_MAGENTA HSL(300, 100, 50)  // Magenta
-#define COLOR_CYAN    HSL(180, 100, 50)  // Cyan
-#define COLOR_WHITE   HSL(0, 0, 100)     // White
-#define COLOR_OFF     HSL(0, 0, 0)       // Black/Off
-
-// Layer color mapping function (only on central or non-split)
+#define HSL(h, s, l) { .r = HSL_R(h, s, l), .g = HSL_G(h, s, l), .b = HSL_B(h, s, l) }
+
+// Color palette using HSL values like dya-dash: X(name, h, s, l)
+#define LED_PALETTE(X) \
+    X(OFF,     0,   0,   0)    /* Black/Off */ \
+    X(RED,     0,   100, 50)   /* Red */ \
+    X(GREEN,   120, 100, 50)   /* Green */ \
+    X(BLUE,    240, 100, 50)   /* Blue */ \
+    X(YELLOW,  60,  100, 50)   /* Yellow */ \
+    X(MAGENTA, 300, 100, 50)   /* Magenta */ \
+    X(CYAN,    180, 100, 50)   /* Cyan */ \
+    X(WHITE,   0,   0,   100)  /* White */
+
+#define LED_PALETTE_ENUM(name, h, s, l) LED_COLOR_##name,
+enum led_color {
+    LED_PALETTE(LED_PALETTE_ENUM)
+    LED_COLOR_COUNT
+};
+
+// Palette resolved at build time and kept in flash
+#define LED_PALETTE_ENTRY(name, h, s, l) [LED_COLOR_##name] = HSL(h, s, l),
+static const struct led_rgb led_palette[LED_COLOR_COUNT] = {
+    LED_PALETTE(LED_PALETTE_ENTRY)
+};
+
+// Every palette entry must match the float reference exactly
+#define LED_PALETTE_CHECK(name, h, s, l) \
+    BUILD_ASSERT(HSL_R(h, s, l) == HSL_REF_R(h, s, l) && \
+                 HSL_G(h, s, l) == HSL_REF_G(h, s, l) && \
+                 HSL_B(h, s, l) == HSL_REF_B(h, s, l), \
+                 "Palette color " #name " does not match the float HSL reference"); \
+    BUILD_ASSERT(LED_COLOR_##name == INDICATOR_LED_COLOR_##name, \
+                 "Palette color " #name " is out of sync with dt-bindings/zmk/indicator_led.h");
+LED_PALETTE(LED_PALETTE_CHECK)
+
+#define COLOR_RED     led_palette[LED_COLOR_RED]       // Red
+#define COLOR_GREEN   led_palette[LED_COLOR_GREEN]     // Green
+#define COLOR_BLUE    led_palette[LED_COLOR_BLUE]      // Blue
+#define COLOR_YELLOW  led_palette[LED_COLOR_YELLOW]    // Yellow
+#define COLOR_MAGENTA led_palette[LED_COLOR_MAGENTA]   // Magenta
+#define COLOR_CYAN    led_palette[LED_COLOR_CYAN]      // Cyan
+#define COLOR_WHITE   led_palette[LED_COLOR_WHITE]     // White
+#define COLOR_OFF     led_palette[LED_COLOR_OFF]       // Black/Off
+
+// Layer color mapping (only on central or non-split)
 #if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+#define KEYMAP_NODE DT_INST(0, zmk_keymap)
+
+// Built-in layer colors, used for layers not covered by the layer-colors property
+#define LAYER_COLOR_BUILTIN(layer) \
+    ((layer) == 0 ? LED_COLOR_OFF :     /* Layer 0 (base): Off/Black */ \
+     (layer) == 1 ? LED_COLOR_RED :     /* Layer 1: Red */ \
+     (layer) == 2 ? LED_COLOR_GREEN :   /* Layer 2: Green */ \
+     (layer) == 3 ? LED_COLOR_YELLOW :  /* Layer 3: Yellow */ \
+     (layer) == 4 ? LED_COLOR_BLUE :    /* Layer 4: Blue */ \
+     (layer) == 5 ? LED_COLOR_MAGENTA : /* Layer 5: Magenta */ \
+     (layer) == 6 ? LED_COLOR_CYAN :    /* Layer 6: Cyan */ \
+     LED_COLOR_WHITE)                   /* Layer 7 and up: White */
+
+#define LAYER_COLOR_FOR_IDX(idx) \
+    COND_CODE_1(DT_PROP_HAS_IDX(INDICATOR_LED_NODE, layer_colors, idx), \
+                (DT_PROP_BY_IDX(INDICATOR_LED_NODE, layer_colors, idx)), \
+                (LAYER_COLOR_BUILTIN(idx)))
+#define LAYER_COLOR_ENTRY(layer_node) LAYER_COLOR_FOR_IDX(DT_NODE_CHILD_IDX(layer_node))
+
+// One palette index per keymap layer, generated from devicetree
+static const uint8_t layer_colors[] = {
+    DT_FOREACH_CHILD_SEP(KEYMAP_NODE, LAYER_COLOR_ENTRY, (,))
+};
+
+#ifdef ZMK_KEYMAP_LAYERS_LEN
+BUILD_ASSERT(LENGTH(layer_colors) == ZMK_KEYMAP_LAYERS_LEN,
+             "Layer color table does not match the keymap");
+#endif
+
+#if DT_NODE_HAS_PROP(INDICATOR_LED_NODE, layer_colors)
+BUILD_ASSERT(DT_PROP_LEN(INDICATOR_LED_NODE, layer_colors) <= LENGTH(layer_colors),
+             "layer-colors has more entries than the keymap has layers");
+
+#define LAYER_COLOR_CHECK(node_id, prop, idx) \
+    BUILD_ASSERT(DT_PROP_BY_IDX(node_id, prop, idx) < LED_COLOR_COUNT, \
+                 "layer-colors entry " #idx " is not a palette color");
+DT_FOREACH_PROP_ELEM(INDICATOR_LED_NODE, layer_colors, LAYER_COLOR_CHECK)
+#endif
+
+// layer must be a keymap layer; resolve_displayed_layer() never returns another one
+static uint8_t get_layer_color_index(uint8_t layer) {
+    return layer_colors[layer];
+}
+
 static struct led_rgb get_layer_color(uint8_t layer) {
-    switch (layer) {
-        case 0: return COLOR_OFF;      // Layer 0 (base): Off/Black
-        case 1: return COLOR_RED;      // Layer 1: Red
-        case 2: return COLOR_GREEN;    // Layer 2: Green
-        case 3: return COLOR_YELLOW;   // Layer 3: Yellow
-        case 4: return COLOR_BLUE;     // Layer 4: Blue
-        case 5: return COLOR_MAGENTA;  // Layer 5: Magenta
-        case 6: return COLOR_CYAN;     // Layer 6: Cyan
-        case 7: return COLOR_WHITE;    // Layer 7: White
-        default: return COLOR_WHITE;   // Default: White
-    }
+    return led_palette[get_layer_color_index(layer)];
 }
 #endif
 
+// Blink pattern catalog: X(id, node name, bytecode...). Each pattern can be
+// replaced by a child node of the same name in the zmk,indicator-led node; see the
+// bytecode description in dt-bindings/zmk/indicator_led.h.
+#define LED_PATTERNS(X) \
+    X(BATTERY_CRITICAL, battery_critical, INDICATOR_LED_MS(40), INDICATOR_LED_MS(40)) \
+    X(BATTERY_HIGH, battery_high, INDICATOR_LED_MS(500), INDICATOR_LED_MS(500)) \
+    X(BATTERY_LOW, battery_low, INDICATOR_LED_MS(100), INDICATOR_LED_MS(100)) \
+    /* When connected, more on than off */ \
+    X(BLE_CONNECTED, ble_connected, INDICATOR_LED_MS(1000), INDICATOR_LED_MS(100)) \
+    /* When open/unpaired, tiny blips. */ \
+    X(BLE_OPEN, ble_open, INDICATOR_LED_MS(80), INDICATOR_LED_MS(80)) \
+    /* When unconnected and searching, more off than on */ \
+    X(BLE_UNCONNECTED, ble_unconnected, INDICATOR_LED_MS(200), INDICATOR_LED_MS(800)) \
+    /* Single soft pulse, for the dense encoding where the color carries the value */ \
+    X(PULSE, pulse, INDICATOR_LED_EASE_OUT, INDICATOR_LED_MS(150), \
+      INDICATOR_LED_EASE_IN_OUT, INDICATOR_LED_MS(450))
+
+#define PATTERN_OP_IS_HOLD(op) ((op) < INDICATOR_LED_SET_COLOR(0))
+#define PATTERN_OP_IS_COLOR(op) ((op) >= INDICATOR_LED_SET_COLOR(0) && (op) < INDICATOR_LED_FADE)
+#define PATTERN_OP_IS_LOOP(op) ((op) >= INDICATOR_LED_LOOP(0))
+#define PATTERN_OP_VALID(op) \
+    ((op) > 0 && (op) <= 0xff && (op) != INDICATOR_LED_LOOP(0) && \
+     ((op) <= INDICATOR_LED_EASE_IN_OUT || PATTERN_OP_IS_LOOP(op)) && \
+     (!PATTERN_OP_IS_COLOR(op) || (op) == INDICATOR_LED_REQUEST_COLOR || \
+      (op) < INDICATOR_LED_SET_COLOR(LED_COLOR_COUNT)))
+#define PATTERN_TIME_UNIT_MS 10
+
+#define LED_PATTERN_NODE(node) DT_CHILD(INDICATOR_LED_NODE, node)
+#define LED_PATTERN_FROM_DT(node) DT_NODE_HAS_PROP(LED_PATTERN_NODE(node), steps)
+#define LED_PATTERN_BYTES(node, ...) \
+    COND_CODE_1(LED_PATTERN_FROM_DT(node), \
+                (DT_FOREACH_PROP_ELEM_SEP(LED_PATTERN_NODE(node), steps, DT_PROP_BY_IDX, (,))), \
+                (__VA_ARGS__))
+#define LED_PATTERN_LEN(node, ...) sizeof((const uint8_t[]){LED_PATTERN_BYTES(node, __VA_ARGS__)})
+
+#define LED_PATTERN_ENUM(id, node, ...) LED_PATTERN_##id,
+enum led_pattern {
+    LED_PATTERNS(LED_PATTERN_ENUM)
+    LED_PATTERN_COUNT
+};
+
+// offsets of the patterns in led_pattern_code
+#define LED_PATTERN_OFFSET_ENUM(id, node, ...) \
+    LED_PATTERN_START_##id, \
+    LED_PATTERN_LAST_##id = LED_PATTERN_START_##id + LED_PATTERN_LEN(node, __VA_ARGS__) - 1,
+enum {
+    LED_PATTERNS(LED_PATTERN_OFFSET_ENUM)
+    LED_PATTERN_CODE_LEN
+};
+BUILD_ASSERT(LED_PATTERN_CODE_LEN <= UINT8_MAX, "Blink pattern catalog is too large");
+
+// all patterns back to back, one byte per instruction
+#define LED_PATTERN_CODE(id, node, ...) LED_PATTERN_BYTES(node, __VA_ARGS__),
+static const uint8_t led_pattern_code[LED_PATTERN_CODE_LEN] = {
+    LED_PATTERNS(LED_PATTERN_CODE)
+};
+
+#define LED_PATTERN_START(id, node, ...) [LED_PATTERN_##id] = LED_PATTERN_START_##id,
+static const uint8_t led_pattern_start[LED_PATTERN_COUNT + 1] = {
+    LED_PATTERNS(LED_PATTERN_START)
+    [LED_PATTERN_COUNT] = LED_PATTERN_CODE_LEN
+};
+
+// Build-time validity checks: only known instructions and at least one hold. A color
+// instruction turns the LED on, so the level only alternates predictably from the
+// last one: the holds after it must be even in number for the pattern to end off.
+// The interpreter keeps a single loop counter, so a pattern may have at most one
+// LOOP, as its last instruction. Instruction positions are tracked in a 64-bit mask.
+#define PATTERN_MAX_LEN 64
+#define LED_PATTERN_DT_OP_VALID(node_id, prop, idx) PATTERN_OP_VALID(DT_PROP_BY_IDX(node_id, prop, idx))
+#define LED_PATTERN_DT_OP_IS_LOOP(node_id, prop, idx) PATTERN_OP_IS_LOOP(DT_PROP_BY_IDX(node_id, prop, idx))
+// one past the position of a LOOP instruction, 0 for anything else
+#define PATTERN_OP_LOOP_END(idx, op) (PATTERN_OP_IS_LOOP(op) ? (idx) + 1 : 0)
+#define LED_PATTERN_DT_OP_LOOP_END(node_id, prop, idx) \
+    PATTERN_OP_LOOP_END(idx, DT_PROP_BY_IDX(node_id, prop, idx))
+// positions of the color instructions, and whether a hold comes after all of them
+#define PATTERN_OP_COLOR_BIT(idx, op) | (PATTERN_OP_IS_COLOR(op) ? BIT64(idx) : 0)
+#define LED_PATTERN_DT_OP_COLOR_BIT(node_id, prop, idx) \
+    PATTERN_OP_COLOR_BIT(idx, DT_PROP_BY_IDX(node_id, prop, idx))
+#define PATTERN_OP_IS_TAIL_HOLD(idx, op, colors) (PATTERN_OP_IS_HOLD(op) && ((colors) >> (idx)) == 0)
+#define LED_PATTERN_DT_OP_IS_TAIL_HOLD(node_id, prop, idx, colors) \
+    PATTERN_OP_IS_TAIL_HOLD(idx, DT_PROP_BY_IDX(node_id, prop, idx), colors)
+#define LED_PATTERN_VALID(node, ...) \
+    COND_CODE_1(LED_PATTERN_FROM_DT(node), \
+                (DT_FOREACH_PROP_ELEM_SEP(LED_PATTERN_NODE(node), steps, LED_PATTERN_DT_OP_VALID, (&&))), \
+                (FOR_EACH(PATTERN_OP_VALID, (&&), __VA_ARGS__)))
+#define LED_PATTERN_TAIL_HOLDS(node, ...) \
+    COND_CODE_1(LED_PATTERN_FROM_DT(node), \
+                (DT_FOREACH_PROP_ELEM_SEP_VARGS(LED_PATTERN_NODE(node), steps, \
+                                                LED_PATTERN_DT_OP_IS_TAIL_HOLD, (+), \
+                                                (0ULL DT_FOREACH_PROP_ELEM(LED_PATTERN_NODE(node), steps, \
+                                                                           LED_PATTERN_DT_OP_COLOR_BIT)))), \
+                (FOR_EACH_IDX_FIXED_ARG(PATTERN_OP_IS_TAIL_HOLD, (+), \
+                                        (0ULL FOR_EACH_IDX(PATTERN_OP_COLOR_BIT, (), __VA_ARGS__)), \
+                                        __VA_ARGS__)))
+#define LED_PATTERN_LOOPS(node, ...) \
+    COND_CODE_1(LED_PATTERN_FROM_DT(node), \
+                (DT_FOREACH_PROP_ELEM_SEP(LED_PATTERN_NODE(node), steps, LED_PATTERN_DT_OP_IS_LOOP, (+))), \
+                (FOR_EACH(PATTERN_OP_IS_LOOP, (+), __VA_ARGS__)))
+#define LED_PATTERN_LOOP_END(node, ...) \
+    COND_CODE_1(LED_PATTERN_FROM_DT(node), \
+                (DT_FOREACH_PROP_ELEM_SEP(LED_PATTERN_NODE(node), steps, LED_PATTERN_DT_OP_LOOP_END, (+))), \
+                (FOR_EACH_IDX(PATTERN_OP_LOOP_END, (+), __VA_ARGS__)))
+#define LED_PATTERN_CHECK(id, node, ...) \
+    BUILD_ASSERT(LED_PATTERN_LEN(node, __VA_ARGS__) <= PATTERN_MAX_LEN, \
+                 "Blink pattern " #node " has more than 64 instructions"); \
+    BUILD_ASSERT(LED_PATTERN_VALID(node, __VA_ARGS__), \
+                 "Blink pattern " #node " contains an invalid instruction or a zero duration"); \
+    BUILD_ASSERT(LED_PATTERN_TAIL_HOLDS(node, __VA_ARGS__) > 0 && \
+                 (LED_PATTERN_TAIL_HOLDS(node, __VA_ARGS__)) % 2 == 0, \
+                 "Blink pattern " #node " must end with an even number of holds after its last color"); \
+    BUILD_ASSERT(LED_PATTERN_LOOPS(node, __VA_ARGS__) == 0 || \
+                 (LED_PATTERN_LOOPS(node, __VA_ARGS__) == 1 && \
+                  LED_PATTERN_LOOP_END(node, __VA_ARGS__) == LED_PATTERN_LEN(node, __VA_ARGS__)), \
+                 "Blink pattern " #node " may only LOOP once, at its end");
+LED_PATTERNS(LED_PATTERN_CHECK)
+
 // flag to indicate whether the initial boot up sequence is complete
 static bool initialized = false;
 
 
-// a blink work item as specified by the blink rate
+// Conditions that end an indication early: once met, the sequence stops at its next
+// step, so the LED shows the live state rather than an outdated one
+enum blink_until {
+    BLINK_UNTIL_NONE,                   // play all repeats
+    BLINK_UNTIL_PROFILE_CONNECTED,      // active BLE profile connected (central)
+    BLINK_UNTIL_PERIPHERAL_CONNECTED,   // split peripheral linked to the central
+    BLINK_UNTIL_COUNT
+};
+
+// The color of a blink item is a palette index, or with BLINK_COLOR_HUE set, a fully
+// saturated hue in BLINK_COLOR_HUE_STEP degree units
+#define BLINK_COLOR_HUE BIT(7)
+#define BLINK_COLOR_HUE_STEP 3
+#define BLINK_COLOR_FROM_HUE(h) (BLINK_COLOR_HUE | ((h) % 360 / BLINK_COLOR_HUE_STEP))
+
+BUILD_ASSERT(LED_COLOR_COUNT <= BLINK_COLOR_HUE, "Palette overlaps the hue color encoding");
+
+// a blink work item: which pattern to play, how often (at most, if it has an end
+// condition) and in which color
 struct blink_item {
-    const uint16_t *sequence;
-    size_t sequence_len;
+    uint8_t pattern;
     uint8_t n_repeats;
-    struct led_rgb color;
+    uint8_t color;
+    uint8_t until;
 };
 
 
-// define message queue of blink work items, that will be processed by a separate thread
-// Max 6 sequences; more in queue will be dropped.
-K_MSGQ_DEFINE(led_msgq, sizeof(struct blink_item), 6, 1);
+// Indication classes, highest priority first. A queued item of a higher class is
+// always played before any lower one; a critical item also cuts short whatever
+// lower-class sequence is playing at that moment.
+enum blink_class {
+    BLINK_CLASS_CRITICAL,       // critical battery
+    BLINK_CLASS_CONNECTIVITY,   // BLE profile / peripheral link status
+    BLINK_CLASS_INFO,           // informational, e.g. battery level on boot
+    BLINK_CLASS_COUNT
+};
 
-static void led_do_blink(struct blink_item blink) {
-    struct led_rgb pixels[1];
-    
-    // 初期消灯 (Initial turn off)
-    pixels[0] = COLOR_OFF;
-    led_strip_update_rgb(led_strip, pixels, 1);
-    k_sleep(K_MSEC(100));
-    
-    // Skip blink sequence if no repeats or no sequence
-    if (blink.n_repeats == 0 || blink.sequence_len == 0) {
+// Indication sources. Each source owns a single latest-wins slot: posting replaces a
+// still-pending request of the same source in O(1) instead of queueing behind it,
+// so a burst of profile changes collapses into the newest state.
+enum indication_source {
+    INDICATION_SRC_BATTERY,     // battery level on boot and critical battery changes
+    INDICATION_SRC_BLE,         // active BLE profile (central)
+    INDICATION_SRC_PERIPHERAL,  // split peripheral link
+    INDICATION_SRC_COUNT
+};
+
+// A pending request is a single-word handle, so posting is one atomic store that is
+// safe from any context, ISRs included. Zero means the slot is empty.
+#define INDICATION_PATTERN_SHIFT 0
+#define INDICATION_REPEATS_SHIFT 8
+#define INDICATION_COLOR_SHIFT 16
+#define INDICATION_CLASS_SHIFT 24
+#define INDICATION_UNTIL_SHIFT 26
+#define INDICATION_PENDING BIT(30)
+
+BUILD_ASSERT(BLINK_CLASS_COUNT <= 4, "Blink class does not fit the indication handle");
+BUILD_ASSERT(BLINK_UNTIL_COUNT <= 4, "End condition does not fit the indication handle");
+
+static atomic_t indication_slots[INDICATION_SRC_COUNT];
+
+static atomic_val_t indication_pack(const struct blink_item *item, enum blink_class item_class) {
+    return INDICATION_PENDING |
+           ((atomic_val_t)item->pattern << INDICATION_PATTERN_SHIFT) |
+           ((atomic_val_t)item->n_repeats << INDICATION_REPEATS_SHIFT) |
+           ((atomic_val_t)item->color << INDICATION_COLOR_SHIFT) |
+           ((atomic_val_t)item_class << INDICATION_CLASS_SHIFT) |
+           ((atomic_val_t)item->until << INDICATION_UNTIL_SHIFT);
+}
+
+static enum blink_class indication_class(atomic_val_t handle) {
+    return (handle >> INDICATION_CLASS_SHIFT) & 0x3;
+}
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+static struct {
+    // requests that replaced a still-pending request of the same source
+    uint32_t coalesced[INDICATION_SRC_COUNT];
+    // worst-case execution time of the layer listener on the event dispatch path
+    uint32_t layer_listener_max_cycles;
+    // strip transfers written vs. elided because the frame did not change
+    uint32_t transfers_issued;
+    uint32_t transfers_skipped;
+    // render stack updates merged into an already pending composition
+    uint32_t frames_superseded;
+    // blink engine wakeups, and transition frames slept through because the output
+    // would not have changed (a fixed-rate loop wakes up for both)
+    uint32_t blink_wakeups;
+    uint32_t frames_slept;
+    // lateness of blink steps against their deadline: 0, 1, 2-3, 4-7, 8-15, 16+ ms
+    uint32_t step_late_ms_hist[BLINK_LATE_BUCKETS];
+    uint32_t step_late_ms_max;
+    // time from picking up an indication until no more were waiting
+    uint32_t drain_ms_last;
+    uint32_t drain_ms_max;
+    // estimated current cut by brightness and budget: on the frame shown, and the
+    // charge saved so far
+    uint32_t current_saved_ua;
+    uint64_t charge_saved_ua_ms;
+    int64_t current_since_ms;
+    // times the strip supply was switched back on
+    uint32_t power_ups;
+    // time spent blanked while idle, and the LED charge that saved (at the current of
+    // the frame that was hidden)
+    uint32_t blanked_ms;
+    uint64_t blank_saved_ua_ms;
+    int64_t blanked_since_ms;
+    uint32_t blanked_frame_ua;
+    // runtime PM of the SPI bus behind the strip
+    uint32_t spi_resumes;
+    uint32_t spi_suspends;
+} led_stats;
+
+#define LED_STATS_INC(field) (led_stats.field++)
+#define LED_STATS_ADD(field, n) (led_stats.field += (n))
+#else
+#define LED_STATS_INC(field)
+#define LED_STATS_ADD(field, n) ((void)(n))
+#endif
+
+static void led_stats_log(void) {
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    LOG_INF("Coalesced indications: battery %u, BLE %u, peripheral %u",
+            led_stats.coalesced[INDICATION_SRC_BATTERY], led_stats.coalesced[INDICATION_SRC_BLE],
+            led_stats.coalesced[INDICATION_SRC_PERIPHERAL]);
+    LOG_INF("Layer listener max %u cycles (%u us)", led_stats.layer_listener_max_cycles,
+            k_cyc_to_us_ceil32(led_stats.layer_listener_max_cycles));
+    LOG_INF("Strip transfers: %u issued, %u skipped", led_stats.transfers_issued,
+            led_stats.transfers_skipped);
+    LOG_INF("Frames superseded before rendering: %u", led_stats.frames_superseded);
+    LOG_INF("Blink engine: %u wakeups, %u unchanged frames slept through",
+            led_stats.blink_wakeups, led_stats.frames_slept);
+    LOG_INF("Step lateness 0/1/2-3/4-7/8-15/16+ ms: %u/%u/%u/%u/%u/%u, max %u ms",
+            led_stats.step_late_ms_hist[0], led_stats.step_late_ms_hist[1],
+            led_stats.step_late_ms_hist[2], led_stats.step_late_ms_hist[3],
+            led_stats.step_late_ms_hist[4], led_stats.step_late_ms_hist[5],
+            led_stats.step_late_ms_max);
+    LOG_INF("Time to drain indications: last %u ms, max %u ms", led_stats.drain_ms_last,
+            led_stats.drain_ms_max);
+    LOG_INF("Brightness and current budget: %u uA saved now, %u mAs saved in total",
+            led_stats.current_saved_ua, (uint32_t)(led_stats.charge_saved_ua_ms / 1000000));
+    LOG_INF("Strip supply switched on %u times", led_stats.power_ups);
+    LOG_INF("Blanked while idle: %u ms, %u mAs saved", led_stats.blanked_ms,
+            (uint32_t)(led_stats.blank_saved_ua_ms / 1000000));
+    LOG_INF("LED SPI bus: %u resumes, %u suspends", led_stats.spi_resumes,
+            led_stats.spi_suspends);
+#endif
+}
+
+static void led_stats_step_late(int64_t late_ms) {
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    uint32_t late = CLAMP(late_ms, 0, UINT32_MAX);
+
+    led_stats.step_late_ms_hist[blink_late_bucket(late)]++;
+    led_stats.step_late_ms_max = MAX(led_stats.step_late_ms_max, late);
+#endif
+}
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+// called with the current saved on each new frame
+static void led_stats_current(uint32_t saved_ua) {
+    int64_t now = k_uptime_get();
+
+    led_stats.charge_saved_ua_ms +=
+        (uint64_t)led_stats.current_saved_ua * (now - led_stats.current_since_ms);
+    led_stats.current_saved_ua = saved_ua;
+    led_stats.current_since_ms = now;
+}
+#endif
+
+static void led_stats_drained(uint32_t drain_ms) {
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    led_stats.drain_ms_last = drain_ms;
+    led_stats.drain_ms_max = MAX(led_stats.drain_ms_max, drain_ms);
+#endif
+}
+
+// Takes the pending request of the highest class out of its slot
+static bool indication_take(struct blink_item *item, enum blink_class *item_class) {
+    atomic_val_t handle;
+    int next;
+
+    do {
+        next = -1;
+        handle = 0;
+        for (int i = 0; i < INDICATION_SRC_COUNT; i++) {
+            atomic_val_t slot = atomic_get(&indication_slots[i]);
+
+            if (slot && (!handle || indication_class(slot) < indication_class(handle))) {
+                next = i;
+                handle = slot;
+            }
+        }
+        if (next < 0) {
+            return false;
+        }
+        // a producer may have replaced the request meanwhile; pick again if so
+    } while (!atomic_cas(&indication_slots[next], handle, 0));
+
+    item->pattern = (handle >> INDICATION_PATTERN_SHIFT) & 0xff;
+    item->n_repeats = (handle >> INDICATION_REPEATS_SHIFT) & 0xff;
+    item->color = (handle >> INDICATION_COLOR_SHIFT) & 0xff;
+    item->until = (handle >> INDICATION_UNTIL_SHIFT) & 0x3;
+    *item_class = indication_class(handle);
+    return true;
+}
+
+// Whether any request of the given class is waiting in a slot
+static bool indication_pending(enum blink_class item_class) {
+    for (int i = 0; i < INDICATION_SRC_COUNT; i++) {
+        atomic_val_t slot = atomic_get(&indication_slots[i]);
+
+        if (slot && indication_class(slot) == item_class) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Number of requests waiting in their slots
+static uint8_t indication_backlog(void) {
+    uint8_t backlog = 0;
+
+    for (int i = 0; i < INDICATION_SRC_COUNT; i++) {
+        backlog += atomic_get(&indication_slots[i]) != 0;
+    }
+    return backlog;
+}
+
+// Shortens a step while other indications are waiting, in proportion to how many,
+// so the current information shows sooner. Steps are not made shorter than the
+// perceptibility floor.
+static uint32_t blink_scale_ms(uint32_t ms) {
+    uint8_t backlog = indication_backlog();
+
+    if (backlog == 0 || ms <= CONFIG_INDICATOR_LED_MIN_STEP_MS) {
+        return ms;
+    }
+    return MAX(ms / (backlog + 1), CONFIG_INDICATOR_LED_MIN_STEP_MS);
+}
+
+// Shadow of the frame last written to the strip. led_commit_frame() skips the SPI
+// transfer when the pixel already shows the requested color. Only called by the
+// render owner below.
+static struct led_rgb committed_frame;
+static bool committed_frame_valid;
+
+#if !IS_ENABLED(CONFIG_INDICATOR_LED_CURVE_NONE)
+// Output brightness curve, generated at build time by scripts/gen_output_lut.py
+static const uint8_t led_output_lut[256] = {
+#include "indicator_led_output_lut.inc"
+};
+
+#define LED_OUTPUT(v) (led_output_lut[v])
+#else
+#define LED_OUTPUT(v) (v)
+#endif
+
+#define LED_BRIGHTNESS_Q8 (CONFIG_INDICATOR_LED_BRIGHTNESS * 256 / 100)
+#define LED_CHANNEL_FULL_UA (CONFIG_INDICATOR_LED_CHANNEL_CURRENT_MA * 1000)
+#define LED_CURRENT_BUDGET_UA (CONFIG_INDICATOR_LED_CURRENT_BUDGET_MA * 1000)
+
+// estimated drive current of a frame after the curve, from its channel sum
+static uint32_t led_frame_current_ua(struct led_rgb color) {
+    return (color.r + color.g + color.b) * LED_CHANNEL_FULL_UA / 255;
+}
+
+// The current budget holds down to the low battery level, then shrinks linearly
+// with the state of charge to CONFIG_INDICATOR_LED_CURRENT_BUDGET_MIN_PERCENT at 0%
+static uint32_t led_current_budget_ua(void) {
+    uint8_t soc = IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING) ? zmk_battery_state_of_charge() : 0;
+
+    // zero means unknown, e.g. right after boot
+    if (soc == 0 || soc >= CONFIG_INDICATOR_LED_BATTERY_LEVEL_LOW) {
+        return LED_CURRENT_BUDGET_UA;
+    }
+    return LED_CURRENT_BUDGET_UA / 100 *
+           (CONFIG_INDICATOR_LED_CURRENT_BUDGET_MIN_PERCENT +
+            (100 - CONFIG_INDICATOR_LED_CURRENT_BUDGET_MIN_PERCENT) * soc /
+                CONFIG_INDICATOR_LED_BATTERY_LEVEL_LOW);
+}
+
+// Last stage before the strip, so layer colors, blinks and fades all go through it:
+// global brightness (ahead of the curve, so it scales perceived brightness), the
+// brightness curve, then the current budget (after the curve, where channel values
+// are proportional to the drive current). Fixed point only.
+static struct led_rgb led_output_stage(struct led_rgb color) {
+    struct led_rgb out = {
+        .r = LED_OUTPUT(color.r * LED_BRIGHTNESS_Q8 >> 8),
+        .g = LED_OUTPUT(color.g * LED_BRIGHTNESS_Q8 >> 8),
+        .b = LED_OUTPUT(color.b * LED_BRIGHTNESS_Q8 >> 8),
+    };
+    uint32_t current_ua = led_frame_current_ua(out);
+    uint32_t budget_ua = led_current_budget_ua();
+
+    if (current_ua > budget_ua) {
+        uint32_t scale_q8 = budget_ua * 256 / current_ua;
+
+        out.r = out.r * scale_q8 >> 8;
+        out.g = out.g * scale_q8 >> 8;
+        out.b = out.b * scale_q8 >> 8;
+    }
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    struct led_rgb full = {
+        .r = LED_OUTPUT(color.r),
+        .g = LED_OUTPUT(color.g),
+        .b = LED_OUTPUT(color.b),
+    };
+
+    led_stats_current(led_frame_current_ua(full) - led_frame_current_ua(out));
+#endif
+    return out;
+}
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_POWER_GATE)
+// Supply of the strip, switched off while the frame is black: an unlit WS2812 still
+// draws about 1 mA. Only used from the system work queue (render owner and blink
+// engine), so plain variables will do.
+static const struct device *led_supply =
+    DEVICE_DT_GET(DT_PHANDLE(INDICATOR_LED_NODE, power_supply));
+
+static bool led_powered;
+static bool led_power_reserved;
+static int64_t led_power_ready_ms;      // uptime from which the strip accepts data
+
+static void led_power_settled_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(led_power_settled_work, led_power_settled_work_handler);
+
+// Switches the supply on if needed; returns 0 once the strip has settled, -EAGAIN
+// while it is settling, or the regulator error
+static int led_power_up(void) {
+    if (!led_powered) {
+        int err = regulator_enable(led_supply);
+
+        if (err) {
+            LOG_ERR("Failed to power up the LED strip (%d)", err);
+            return err;
+        }
+        led_powered = true;
+        led_power_ready_ms = k_uptime_get() + DT_PROP(INDICATOR_LED_NODE, power_settle_ms);
+        LED_STATS_INC(power_ups);
+    }
+    return k_uptime_get() >= led_power_ready_ms ? 0 : -EAGAIN;
+}
+
+// Switches the supply off unless a blink sequence holds it; returns whether the
+// strip is unpowered
+static bool led_power_down(void) {
+    if (led_powered && !led_power_reserved && regulator_disable(led_supply) == 0) {
+        led_powered = false;
+    }
+    return !led_powered;
+}
+
+// Keeps the supply on across the black steps of a blink sequence, and powers up
+// ahead of its first lit frame so that the settle time is hidden
+static void led_power_reserve(void) {
+    led_power_reserved = true;
+    led_power_up();
+}
+
+static void led_power_release(void) {
+    led_power_reserved = false;
+}
+#else
+static int led_power_up(void) {
+    return 0;
+}
+
+static bool led_power_down(void) {
+    return false;
+}
+
+static void led_power_reserve(void) {}
+static void led_power_release(void) {}
+#endif
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_SPI_RUNTIME_PM) && DT_ON_BUS(LED_STRIP_NODE_ID, spi)
+#define LED_SPI_NODE DT_BUS(LED_STRIP_NODE_ID)
+#define LED_SPI_COUNT_DEVICE(node_id) +1
+
+// SPI bus behind the strip. Resumed for frame commits and suspended again once the
+// strip has been static for CONFIG_INDICATOR_LED_SPI_AUTOSUSPEND_MS, so the
+// peripheral and its clock don't stay on while the LED holds a layer color. Only
+// used from the system work queue.
+static const struct device *led_spi = DEVICE_DT_GET(LED_SPI_NODE);
+static bool led_spi_held;
+
+static void led_spi_suspend(void) {
+    if (led_spi_held && pm_device_runtime_put(led_spi) == 0) {
+        led_spi_held = false;
+        LED_STATS_INC(spi_suspends);
+        LOG_DBG("LED SPI bus released");
+    }
+}
+
+static void led_spi_autosuspend_work_handler(struct k_work *work) {
+    led_spi_suspend();
+}
+
+static K_WORK_DELAYABLE_DEFINE(led_spi_autosuspend_work, led_spi_autosuspend_work_handler);
+
+// Resumes the bus if needed; returns 0 once it can take a transfer
+static int led_spi_get(void) {
+    if (!led_spi_held) {
+        int err = pm_device_runtime_get(led_spi);
+
+        if (err) {
+            LOG_ERR("Failed to resume the LED SPI bus (%d)", err);
+            return err;
+        }
+        led_spi_held = true;
+        LED_STATS_INC(spi_resumes);
+        LOG_DBG("LED SPI bus resumed");
+    }
+    return 0;
+}
+
+static void led_spi_put(void) {
+    k_work_reschedule(&led_spi_autosuspend_work, K_MSEC(CONFIG_INDICATOR_LED_SPI_AUTOSUSPEND_MS));
+}
+
+static void led_spi_pm_init(void) {
+    // a bus shared with other devices is left to devicetree (zephyr,pm-device-runtime-auto),
+    // as their drivers may not resume it themselves
+    if ((0 DT_FOREACH_CHILD_STATUS_OKAY(LED_SPI_NODE, LED_SPI_COUNT_DEVICE)) == 1 &&
+        !pm_device_runtime_is_enabled(led_spi)) {
+        pm_device_runtime_enable(led_spi);
+    }
+}
+#else
+static void led_spi_suspend(void) {}
+static int led_spi_get(void) {
+    return 0;
+}
+static void led_spi_put(void) {}
+static void led_spi_pm_init(void) {}
+#endif
+
+static void led_commit_frame(struct led_rgb color) {
+    color = led_output_stage(color);
+
+    if (!color.r && !color.g && !color.b) {
+        if (led_power_down()) {
+            // nothing to send, and the strip forgets its state without power
+            committed_frame_valid = false;
+            return;
+        }
+        // A blink sequence holds the supply, which may still be settling; a strip
+        // comes up dark, so losing this black frame is harmless.
+    } else {
+        int err = led_power_up();
+
+        if (err) {
+#if IS_ENABLED(CONFIG_INDICATOR_LED_POWER_GATE)
+            if (err == -EAGAIN) {
+                // composed and sent again once the supply has settled
+                k_work_schedule(&led_power_settled_work,
+                                K_TIMEOUT_ABS_MS(led_power_ready_ms));
+            }
+#endif
+            // an unpowered strip holds nothing; write the next frame for sure
+            committed_frame_valid = false;
+            return;
+        }
+    }
+
+    if (committed_frame_valid && committed_frame.r == color.r &&
+        committed_frame.g == color.g && committed_frame.b == color.b) {
+        LED_STATS_INC(transfers_skipped);
         return;
     }
-    
-    for (int n = 0; n < blink.n_repeats; n++) {
-        for (int i = 0; i < blink.sequence_len; i++) {
-            // On for evens (0 == start), off for odds
-            if (i % 2 == 0) {
-                pixels[0] = blink.color;  // 指定色で点灯
-            } else {
-                pixels[0] = COLOR_OFF;    // 消灯
+
+    struct led_rgb pixels[1] = {color};
+    int err = led_spi_get();
+
+    if (err) {
+        // the strip wasn't written; send this frame again next time
+        committed_frame_valid = false;
+        return;
+    }
+    err = led_strip_update_rgb(led_strip, pixels, 1);
+    led_spi_put();
+
+    // on failure leave the shadow invalid so the next frame is written for sure
+    committed_frame = color;
+    committed_frame_valid = (err == 0);
+    LED_STATS_INC(transfers_issued);
+}
+
+// called when the LED is blanked or shown again, before the frame changes
+static void led_stats_blanked(bool blank) {
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    int64_t now = k_uptime_get();
+
+    if (blank) {
+        led_stats.blanked_since_ms = now;
+        led_stats.blanked_frame_ua =
+            committed_frame_valid ? led_frame_current_ua(committed_frame) : 0;
+    } else {
+        led_stats.blanked_ms += now - led_stats.blanked_since_ms;
+        led_stats.blank_saved_ua_ms +=
+            (uint64_t)led_stats.blanked_frame_ua * (now - led_stats.blanked_since_ms);
+    }
+#endif
+}
+
+// Render owner: render_work is the only context that touches the strip. Producers
+// don't write frames directly, they update their layer of the render stack and kick
+// render_work, which composes the stack and sends the result in one strip
+// transaction. Each layer is a single atomic word, so layer and blink updates can't
+// interleave on the bus and no mutex is needed.
+//
+// The base layer holds the persistent layer color; the overlay holds the current
+// blink frame and overrides the base while set. Clearing the overlay brings the
+// cached base color back without asking the keymap again.
+enum render_layer {
+    RENDER_LAYER_BASE,
+    RENDER_LAYER_OVERLAY,
+    RENDER_LAYER_COUNT
+};
+
+#define RENDER_LAYER_SET BIT(24)
+
+static atomic_t render_layers[RENDER_LAYER_COUNT];
+static atomic_t render_dirty;
+// while set, the stack is kept but the LED shows off (keyboard idle)
+static atomic_t render_blanked;
+
+static atomic_val_t render_pack(struct led_rgb color) {
+    return ((atomic_val_t)color.r << 16) | ((atomic_val_t)color.g << 8) | color.b;
+}
+
+static struct led_rgb render_unpack(atomic_val_t frame) {
+    return (struct led_rgb){
+        .r = (frame >> 16) & 0xff,
+        .g = (frame >> 8) & 0xff,
+        .b = frame & 0xff,
+    };
+}
+
+static void render_work_handler(struct k_work *work) {
+    if (!atomic_clear(&render_dirty)) {
+        return;
+    }
+
+    // topmost layer that is set wins; nothing set means off
+    struct led_rgb frame = COLOR_OFF;
+    if (!atomic_get(&render_blanked)) {
+        for (int i = RENDER_LAYER_COUNT - 1; i >= 0; i--) {
+            atomic_val_t layer = atomic_get(&render_layers[i]);
+
+            if (layer & RENDER_LAYER_SET) {
+                frame = render_unpack(layer);
+                break;
             }
-            led_strip_update_rgb(led_strip, pixels, 1);
-            
-            uint16_t blink_time = blink.sequence[i];
-            k_sleep(K_MSEC(blink_time));
         }
-        
-        // Brief pause between repetitions
-        if (n < blink.n_repeats - 1) {
-            pixels[0] = COLOR_OFF;
-            led_strip_update_rgb(led_strip, pixels, 1);
-            k_sleep(K_MSEC(150));
+    }
+    led_commit_frame(frame);
+}
+
+static K_WORK_DEFINE(render_work, render_work_handler);
+
+// Composes and sends the stack again although no layer changed
+static void render_refresh(void) {
+    atomic_set(&render_dirty, 1);
+    k_work_submit(&render_work);
+}
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_POWER_GATE)
+static void led_power_settled_work_handler(struct k_work *work) {
+    render_refresh();
+}
+#endif
+
+// Blanks the LED or shows the stack again, without touching its layers, so the
+// cached frame comes back at once; safe from any context
+static void led_render_blank(bool blank) {
+    if (atomic_set(&render_blanked, blank) != blank) {
+        led_stats_blanked(blank);
+        render_refresh();
+    }
+}
+
+static void render_layer_store(enum render_layer layer, atomic_val_t value) {
+    atomic_set(&render_layers[layer], value);
+    if (atomic_set(&render_dirty, 1)) {
+        LED_STATS_INC(frames_superseded);
+    }
+    k_work_submit(&render_work);
+}
+
+// Sets the color of a render layer; safe from any context
+static void led_render(enum render_layer layer, struct led_rgb color) {
+    render_layer_store(layer, render_pack(color) | RENDER_LAYER_SET);
+}
+
+// Removes a render layer so the ones below show through again; safe from any context
+static void led_render_clear(enum render_layer layer) {
+    render_layer_store(layer, 0);
+}
+
+// Blink engine: a state machine on the system work queue. Every step updates the
+// LED, schedules the deadline of the next step and returns, so no thread is kept
+// around just to sleep through the sequences.
+enum blink_phase {
+    BLINK_IDLE,         // waiting for the next pending indication slot
+    BLINK_STEP,         // interpreting the pattern of the current repeat
+    BLINK_FINISH,       // sequence done, turn off and wait the interval
+};
+
+BUILD_ASSERT(INDICATOR_LED_EASE_IN_OUT - INDICATOR_LED_FADE + EASE_LINEAR == EASE_IN_OUT,
+             "Easing instructions are out of sync with the easing curves");
+
+// frame period of transitions
+#define BLINK_FRAME_MS (1000 / CONFIG_INDICATOR_LED_FRAME_RATE)
+
+static struct {
+    struct blink_item item;
+    enum blink_class item_class;
+    enum blink_phase phase;
+    uint8_t repeat;
+    // uptime at which the current step was due. Steps are scheduled on absolute
+    // deadlines from the sequence start, so wakeup latency doesn't add up.
+    int64_t deadline_ms;
+    // uptime at which the engine picked up work after being idle
+    int64_t busy_since_ms;
+
+    struct led_rgb item_color;  // color of the indication
+
+    // pattern interpreter
+    uint8_t pc;             // next instruction, relative to the pattern start
+    uint8_t loops;          // times the current loop instruction jumped back
+    bool level_on;          // level of the next hold
+    uint8_t ease_next;      // transition into the next hold
+    struct led_rgb color;   // color while on
+    struct led_rgb shown;   // last frame put on the overlay
+
+    // transition in progress, if keyframe.active
+    struct blink_keyframe keyframe;
+} blink_state;
+
+// set by led_blink_cancel() to stop the current sequence at its next step
+static atomic_t blink_cancelled;
+
+static void blink_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(blink_work, blink_work_handler);
+
+static void blink_show(struct led_rgb color) {
+    blink_state.shown = color;
+    led_render(RENDER_LAYER_OVERLAY, color);
+}
+
+// Resolves the color of a blink item, once per sequence
+static struct led_rgb blink_item_color(uint8_t color) {
+    if (color & BLINK_COLOR_HUE) {
+        return hsl_to_rgb((color & ~BLINK_COLOR_HUE) * BLINK_COLOR_HUE_STEP, 100, 50);
+    }
+    return led_palette[color];
+}
+
+static void blink_pattern_start(void) {
+    blink_state.pc = 0;
+    blink_state.loops = 0;
+    blink_state.level_on = true;
+    blink_state.ease_next = EASE_STEP;
+    blink_state.color = blink_state.item_color;
+    blink_state.keyframe.active = false;
+}
+
+// Advances the transition in progress to the next frame that changes the output.
+// Returns the time until that frame.
+static uint32_t blink_keyframe_next(void) {
+    uint32_t slept = 0;
+    uint32_t delay_ms = blink_keyframe_advance(&blink_state.keyframe, blink_state.shown, &slept);
+
+    LED_STATS_ADD(frames_slept, slept);
+    return delay_ms;
+}
+
+// Shows the frame that is due. Returns the time until the next one, or 0 once the
+// transition has reached its target.
+static uint32_t blink_keyframe_frame(void) {
+    struct blink_keyframe *kf = &blink_state.keyframe;
+
+    blink_show(kf->next);
+    if (kf->remaining_ms == 0) {
+        kf->active = false;
+        return 0;
+    }
+    return blink_keyframe_next();
+}
+
+// Moves to target over duration_ms along the given easing curve and returns the time
+// until the next step
+static uint32_t blink_transition(struct led_rgb target, uint16_t duration_ms, uint8_t ease) {
+    if (!blink_keyframe_start(&blink_state.keyframe, blink_state.shown, target, duration_ms,
+                              ease, BLINK_FRAME_MS)) {
+        blink_show(target);
+        return duration_ms;
+    }
+    return blink_keyframe_next();
+}
+
+// Runs the pattern up to and including its next hold. Returns the time until the
+// next step, or 0 once the pattern has ended.
+static uint32_t blink_pattern_step(void) {
+    const uint8_t *code = &led_pattern_code[led_pattern_start[blink_state.item.pattern]];
+    uint8_t len = led_pattern_start[blink_state.item.pattern + 1] -
+                  led_pattern_start[blink_state.item.pattern];
+
+    if (blink_state.keyframe.active) {
+        uint32_t delay_ms = blink_keyframe_frame();
+
+        if (delay_ms > 0) {
+            return delay_ms;
+        }
+    }
+
+    while (blink_state.pc < len) {
+        uint8_t op = code[blink_state.pc++];
+
+        if (PATTERN_OP_IS_HOLD(op)) {
+            // 指定色で点灯 / 消灯 (on in the current color / off), then toggle
+            struct led_rgb target = blink_state.level_on ? blink_state.color : COLOR_OFF;
+            uint8_t ease = blink_state.ease_next;
+
+            blink_state.level_on = !blink_state.level_on;
+            blink_state.ease_next = EASE_STEP;
+            return blink_transition(target, blink_scale_ms(op * PATTERN_TIME_UNIT_MS), ease);
+        } else if (PATTERN_OP_IS_COLOR(op)) {
+            blink_state.color = op == INDICATOR_LED_REQUEST_COLOR
+                                    ? blink_state.item_color
+                                    : led_palette[op - INDICATOR_LED_SET_COLOR(0)];
+            blink_state.level_on = true;
+        } else if (op <= INDICATOR_LED_EASE_IN_OUT) {
+            blink_state.ease_next = op - INDICATOR_LED_FADE + EASE_LINEAR;
+        } else if (blink_state.loops < op - INDICATOR_LED_LOOP(0)) {
+            // the trailing LOOP (checked at build time): play again from the start,
+            // on and in the color of the indication
+            uint8_t loops = blink_state.loops + 1;
+
+            blink_pattern_start();
+            blink_state.loops = loops;
+        } else {
+            blink_state.loops = 0;
         }
     }
-    
-    // Final turn off unless it's a "stay on" pattern
-    if (blink.sequence != STAY_ON) {
-        pixels[0] = COLOR_OFF;
-        led_strip_update_rgb(led_strip, pixels, 1);
+    return 0;
+}
+
+// Whether the end condition of an indication has been met
+static bool blink_until_met(uint8_t until) {
+    switch (until) {
+#if IS_ENABLED(CONFIG_ZMK_BLE) && \
+    (!IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL))
+    case BLINK_UNTIL_PROFILE_CONNECTED:
+        return zmk_ble_active_profile_is_connected();
+#endif
+#if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_PERIPHERAL_BLE) && \
+    IS_ENABLED(CONFIG_ZMK_SPLIT) && \
+    !IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+    case BLINK_UNTIL_PERIPHERAL_CONNECTED:
+        return zmk_split_bt_peripheral_is_connected();
+#endif
+    default:
+        return false;
     }
 }
 
+static void blink_work_handler(struct k_work *work) {
+    uint32_t delay_ms;
+
+    LED_STATS_INC(blink_wakeups);
+
+    if (atomic_cas(&blink_cancelled, 1, 0) && blink_state.phase != BLINK_IDLE) {
+        LOG_DBG("Blink sequence cancelled");
+        led_power_release();
+        led_render_clear(RENDER_LAYER_OVERLAY);
+        blink_state.phase = BLINK_IDLE;
+    }
+    if (blink_state.phase != BLINK_IDLE) {
+        led_stats_step_late(k_uptime_get() - blink_state.deadline_ms);
+    }
+
+    switch (blink_state.phase) {
+    case BLINK_IDLE:
+        // while blanked, requests wait in their slots and play once active again
+        if (atomic_get(&render_blanked) ||
+            !indication_take(&blink_state.item, &blink_state.item_class)) {
+            // nothing left to play; led_blink_post() kicks us again
+            return;
+        }
+        LOG_DBG("Got a class %d blink item", blink_state.item_class);
+        blink_state.deadline_ms = k_uptime_get();
+        if (blink_state.busy_since_ms == 0) {
+            blink_state.busy_since_ms = blink_state.deadline_ms;
+        }
+
+        // boot feedback latency: time from power-on to the first indication
+        static bool first_indication_shown;
+        if (!first_indication_shown) {
+            first_indication_shown = true;
+            LOG_INF("First indication %lld ms after power-on", k_uptime_get());
+        }
+
+        // 初期消灯 (Initial turn off), while the strip powers up
+        led_power_reserve();
+        blink_show(COLOR_OFF);
+        blink_state.item_color = blink_item_color(blink_state.item.color);
+        blink_state.repeat = 0;
+        blink_pattern_start();
+        // Skip blink sequence if no repeats
+        if (blink_state.item.n_repeats == 0) {
+            blink_state.phase = BLINK_FINISH;
+        } else {
+            blink_state.phase = BLINK_STEP;
+        }
+        delay_ms = blink_scale_ms(100);
+        break;
+
+    case BLINK_STEP:
+        if (blink_until_met(blink_state.item.until)) {
+            LOG_DBG("End condition of the indication met");
+        } else {
+            delay_ms = blink_pattern_step();
+            if (delay_ms > 0) {
+                break;
+            }
+
+            if (++blink_state.repeat < blink_state.item.n_repeats) {
+                // Brief pause between repetitions
+                blink_show(COLOR_OFF);
+                blink_pattern_start();
+                delay_ms = blink_scale_ms(150);
+                break;
+            }
+        }
+        __fallthrough;
+
+    case BLINK_FINISH:
+    default:
+        // Drop the overlay, back to the layer color
+        led_power_release();
+        led_render_clear(RENDER_LAYER_OVERLAY);
+        blink_state.phase = BLINK_IDLE;
+        bool drained = indication_backlog() == 0;
+
+        if (drained) {
+            uint32_t drain_ms = k_uptime_get() - blink_state.busy_since_ms;
+
+            LOG_DBG("Indications drained in %u ms", drain_ms);
+            led_stats_drained(drain_ms);
+            blink_state.busy_since_ms = 0;
+        }
+        led_stats_log();
+        if (drained) {
+            // Nothing to keep apart from: sleep until led_blink_post() kicks us, and
+            // let a new item start right after the floor
+            blink_deadline_advance(&blink_state.deadline_ms, CONFIG_INDICATOR_LED_MIN_STEP_MS);
+            return;
+        }
+        // wait interval before processing another blink sequence
+        delay_ms = blink_scale_ms(CONFIG_INDICATOR_LED_INTERVAL_MS);
+        break;
+    }
+
+    k_work_schedule(&blink_work,
+                    K_TIMEOUT_ABS_MS(blink_deadline_advance(&blink_state.deadline_ms, delay_ms)));
+}
+
+// Stops the sequence that is currently playing at its next step
+static void led_blink_cancel(void) {
+    atomic_set(&blink_cancelled, 1);
+    k_work_reschedule(&blink_work, K_NO_WAIT);
+}
+
+// Starts the engine if it is idle, or preempts a lower-class sequence when a
+// critical item is waiting. Runs on the system work queue like the engine itself,
+// so the state checks cannot race with a running step.
+static void blink_kick_work_handler(struct k_work *work) {
+    if (atomic_get(&render_blanked)) {
+        return;
+    }
+    if (blink_state.phase == BLINK_IDLE) {
+        if (indication_pending(BLINK_CLASS_CRITICAL)) {
+            // don't make a critical item sit out the rest of the interval
+            k_work_reschedule(&blink_work, K_NO_WAIT);
+        } else if (!k_work_delayable_is_pending(&blink_work)) {
+            // no earlier than the floor after the last sequence, which may be past
+            k_work_schedule(&blink_work, K_TIMEOUT_ABS_MS(blink_state.deadline_ms));
+        }
+    } else if (blink_state.item_class > BLINK_CLASS_CRITICAL &&
+               indication_pending(BLINK_CLASS_CRITICAL)) {
+        LOG_DBG("Critical indication preempts class %d sequence", blink_state.item_class);
+        led_blink_cancel();
+    }
+}
+
+static K_WORK_DEFINE(blink_kick_work, blink_kick_work_handler);
+
+// Posts a blink request into the slot of its source, replacing any request of that
+// source which has not started playing yet; safe from any context
+static void led_blink_post(enum indication_source source, const struct blink_item *blink,
+                           enum blink_class blink_class) {
+    if (atomic_set(&indication_slots[source], indication_pack(blink, blink_class))) {
+        LED_STATS_INC(coalesced[source]);
+    }
+    k_work_submit(&blink_kick_work);
+}
+
 #if IS_ENABLED(CONFIG_ZMK_BLE) && IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_BLE)
+#if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
+// Dense encoding: hues spread evenly over the profiles, starting from blue
+#define PROFILE_HUE(i, _) BLINK_COLOR_FROM_HUE(240 + (i) * 360 / CONFIG_ZMK_BLE_PROFILE_COUNT)
+static const uint8_t profile_hues[] = {
+    LISTIFY(CONFIG_ZMK_BLE_PROFILE_COUNT, PROFILE_HUE, (,))
+};
+#endif
+
 static void indicate_ble(void) {
     struct blink_item blink = {};
 
 #if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
     uint8_t profile_index = zmk_ble_active_profile_index() + 1;
-    if (zmk_ble_active_profile_is_connected()) {
+    if (IS_ENABLED(CONFIG_INDICATOR_LED_DENSE_ENCODING)) {
+        // the profile is in the color, the state in the pattern
+        blink.color = profile_hues[profile_index - 1];
+        blink.n_repeats = 1;
+        if (zmk_ble_active_profile_is_connected()) {
+            LOG_INF("Profile %d connected, pulsing", profile_index);
+            blink.pattern = LED_PATTERN_PULSE;
+        } else if (zmk_ble_active_profile_is_open()) {
+            LOG_INF("Profile %d open, flickering", profile_index);
+            blink.pattern = LED_PATTERN_BLE_OPEN;
+            blink.n_repeats = 3;
+            blink.until = BLINK_UNTIL_PROFILE_CONNECTED;
+        } else {
+            LOG_INF("Profile %d not connected, blinking", profile_index);
+            blink.pattern = LED_PATTERN_BLE_UNCONNECTED;
+            blink.until = BLINK_UNTIL_PROFILE_CONNECTED;
+        }
+    } else if (zmk_ble_active_profile_is_connected()) {
         LOG_INF("Profile %d connected, blinking blue", profile_index);
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_BLE_PROFILE_CONNECTED_PATTERN);
+        blink.pattern = LED_PATTERN_BLE_CONNECTED;
         blink.n_repeats = profile_index;
-        blink.color = COLOR_BLUE;      // 接続: 青
+        blink.color = LED_COLOR_BLUE;      // 接続: 青
     } else if (zmk_ble_active_profile_is_open()) {
         LOG_INF("Profile %d open, blinking cyan", profile_index);
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_BLE_PROFILE_OPEN_PATTERN);
+        blink.pattern = LED_PATTERN_BLE_OPEN;
         blink.n_repeats = profile_index;
-        blink.color = COLOR_CYAN;      // 広告中: シアン
+        blink.color = LED_COLOR_CYAN;      // 広告中: シアン
+        blink.until = BLINK_UNTIL_PROFILE_CONNECTED;
     } else {
         LOG_INF("Profile %d not connected, blinking magenta", profile_index);
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_PROFILE_UNCONNECTED_PATTERN);
+        blink.pattern = LED_PATTERN_BLE_UNCONNECTED;
         blink.n_repeats = profile_index;
-        blink.color = COLOR_MAGENTA;   // 未接続: マゼンタ
+        blink.color = LED_COLOR_MAGENTA;   // 未接続: マゼンタ
+        blink.until = BLINK_UNTIL_PROFILE_CONNECTED;
     }
-    k_msgq_put(&led_msgq, &blink, K_NO_WAIT);
+    led_blink_post(INDICATION_SRC_BLE, &blink, BLINK_CLASS_CONNECTIVITY);
 #endif
 #if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_PERIPHERAL_BLE) && \
     IS_ENABLED(CONFIG_ZMK_SPLIT) && \
     !IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
     if (zmk_split_bt_peripheral_is_connected()) {
         LOG_INF("Peripheral connected, blinking blue");
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_BLE_PROFILE_CONNECTED_PATTERN);
+        blink.pattern = LED_PATTERN_BLE_CONNECTED;
         blink.n_repeats = 1;
-        blink.color = COLOR_BLUE;      // 接続: 青
+        blink.color = LED_COLOR_BLUE;      // 接続: 青
     } else {
         LOG_INF("Peripheral not connected, blinking magenta");
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_PROFILE_UNCONNECTED_PATTERN);
+        blink.pattern = LED_PATTERN_BLE_UNCONNECTED;
         blink.n_repeats = 10;
-        blink.color = COLOR_MAGENTA;   // 未接続: マゼンタ
+        blink.color = LED_COLOR_MAGENTA;   // 未接続: マゼンタ
+        blink.until = BLINK_UNTIL_PERIPHERAL_CONNECTED;
     }
-    k_msgq_put(&led_msgq, &blink, K_NO_WAIT);
+    led_blink_post(INDICATION_SRC_PERIPHERAL, &blink, BLINK_CLASS_CONNECTIVITY);
 #endif
 
 }
@@ -245,69 +1261,89 @@ ZMK_SUBSCRIPTION(led_output_listener, zmk_split_peripheral_status_changed);
 
 #if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING)
 
-#if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_CRITICAL_BATTERY_CHANGES)
 static int led_battery_listener_cb(const zmk_event_t *eh) {
     if (!initialized) {
         return 0;
     }
 
+    // the current budget follows the charge, so tighten it on the frame already shown
+    render_refresh();
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_CRITICAL_BATTERY_CHANGES)
     // check if we are in critical battery levels at state change, blink if we are
     uint8_t battery_level = as_zmk_battery_state_changed(eh)->state_of_charge;
 
     if (battery_level > 0 && battery_level <= CONFIG_INDICATOR_LED_BATTERY_LEVEL_CRITICAL) {
         LOG_INF("Battery level %d, blinking for critical", battery_level);
 
-        struct blink_item blink = BLINK_STRUCT(
-            CONFIG_INDICATOR_LED_BATTERY_CRITICAL_PATTERN, 1, COLOR_RED
-        );
-        k_msgq_put(&led_msgq, &blink, K_NO_WAIT);
+        struct blink_item blink = {
+            .pattern = LED_PATTERN_BATTERY_CRITICAL,
+            .n_repeats = 1,
+            .color = LED_COLOR_RED,
+        };
+        led_blink_post(INDICATION_SRC_BATTERY, &blink, BLINK_CLASS_CRITICAL);
     }
+#endif
     return 0;
 }
 // run led_battery_listener_cb on battery state change event
 ZMK_LISTENER(led_battery_listener, led_battery_listener_cb);
 ZMK_SUBSCRIPTION(led_battery_listener, zmk_battery_state_changed);
-#endif
 
 #if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_BATTERY_ON_BOOT)
-static void indicate_startup_battery(void) {
-    // check and indicate battery level on thread start
-    LOG_INF("Indicating initial battery status");
+// number of 100 ms retries while the battery level still reads zero
+#define STARTUP_BATTERY_RETRIES 10
+
+// Returns false while the battery level is still undetermined and worth retrying
+static bool indicate_startup_battery(void) {
+    static int retry;
 
     struct blink_item blink = {};
+    enum blink_class blink_class = BLINK_CLASS_INFO;
     uint8_t battery_level = zmk_battery_state_of_charge();
-    int retry = 0;
-    while (battery_level == 0 && retry++ < 10) {
-        k_sleep(K_MSEC(100));
-        battery_level = zmk_battery_state_of_charge();
-    };
+    if (battery_level == 0 && retry++ < STARTUP_BATTERY_RETRIES) {
+        return false;
+    }
+
+    // check and indicate battery level once it is known
+    LOG_INF("Indicating initial battery status");
 
     if (battery_level == 0) {
         LOG_INF("Startup Battery level undetermined (zero), blinking off");
-        blink.sequence_len = 0;
         blink.n_repeats = 0;
-        blink.color = COLOR_OFF;
+        blink.color = LED_COLOR_OFF;
+    } else if (IS_ENABLED(CONFIG_INDICATOR_LED_DENSE_ENCODING)) {
+        // one pulse on a red (empty) to green (full) gradient
+        LOG_INF("Startup Battery level %d, pulsing", battery_level);
+        blink.pattern = LED_PATTERN_PULSE;
+        blink.n_repeats = 1;
+        blink.color = BLINK_COLOR_FROM_HUE(MIN(battery_level, 100) * 120 / 100);
+        if (battery_level <= CONFIG_INDICATOR_LED_BATTERY_LEVEL_CRITICAL) {
+            blink_class = BLINK_CLASS_CRITICAL;
+        }
     } else if (battery_level >= CONFIG_INDICATOR_LED_BATTERY_LEVEL_HIGH) {
         LOG_INF("Startup Battery level %d, blinking green", battery_level);
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_BATTERY_HIGH_PATTERN);
+        blink.pattern = LED_PATTERN_BATTERY_HIGH;
         blink.n_repeats = CONFIG_INDICATOR_LED_BATTERY_HIGH_BLINK_REPEAT;
-        blink.color = COLOR_GREEN;     // 高: 緑
+        blink.color = LED_COLOR_GREEN;     // 高: 緑
     } else if (battery_level <= CONFIG_INDICATOR_LED_BATTERY_LEVEL_CRITICAL){
         LOG_INF("Startup Battery level %d, blinking red", battery_level);
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_BATTERY_CRITICAL_PATTERN);
+        blink.pattern = LED_PATTERN_BATTERY_CRITICAL;
         blink.n_repeats = CONFIG_INDICATOR_LED_BATTERY_CRITICAL_BLINK_REPEAT;
-        blink.color = COLOR_RED;       // 危険: 赤
+        blink.color = LED_COLOR_RED;       // 危険: 赤
+        blink_class = BLINK_CLASS_CRITICAL;
     } else if (battery_level <= CONFIG_INDICATOR_LED_BATTERY_LEVEL_LOW) {
         LOG_INF("Startup Battery level %d, blinking yellow", battery_level);
-        SET_BLINK_SEQUENCE(CONFIG_INDICATOR_LED_BATTERY_LOW_PATTERN);
+        blink.pattern = LED_PATTERN_BATTERY_LOW;
         blink.n_repeats = CONFIG_INDICATOR_LED_BATTERY_LOW_BLINK_REPEAT;
-        blink.color = COLOR_YELLOW;    // 低: 黄
+        blink.color = LED_COLOR_YELLOW;    // 低: 黄
     } else {
         blink.n_repeats = 0;
-        blink.color = COLOR_OFF;
+        blink.color = LED_COLOR_OFF;
     }
 
-    k_msgq_put(&led_msgq, &blink, K_NO_WAIT);
+    led_blink_post(INDICATION_SRC_BATTERY, &blink, blink_class);
+    return true;
 }
 #endif
 
@@ -319,77 +1355,65 @@ static void indicate_startup_battery(void) {
 static void set_layer_color(uint8_t layer) {
     struct led_rgb pixels[1];
     
-    // Get color for the layer using HSL-based function
+    // Get color for the layer from the palette
     pixels[0] = get_layer_color(layer);
     
-    LOG_INF("Setting LED: layer=%d, RGB=(%d,%d,%d)", 
+    LOG_DBG("Setting LED: layer=%d, RGB=(%d,%d,%d)", 
             layer, pixels[0].r, pixels[0].g, pixels[0].b);
     
-    // Set LED to the layer color
-    led_strip_update_rgb(led_strip, pixels, 1);
-    
-    LOG_INF("LED updated successfully for layer %d", layer);
+    // The layer color is the base of the render stack, blinks are drawn over it
+    led_render(RENDER_LAYER_BASE, pixels[0]);
+}
+
+// Highest active layer within CONFIG_INDICATOR_LED_DISPLAYABLE_LAYERS, resolved from
+// one read of the layer state bitmap with a find-most-significant-bit, so the cost
+// does not depend on the number of layers. Falls back to the keymap's default layer,
+// like zmk_keymap_highest_layer_active().
+#define DISPLAYABLE_LAYERS_MASK \
+    ((uint32_t)(CONFIG_INDICATOR_LED_DISPLAYABLE_LAYERS & BIT64_MASK(LENGTH(layer_colors))))
+
+static uint8_t resolve_displayed_layer(void) {
+    uint32_t state = zmk_keymap_layer_state() & DISPLAYABLE_LAYERS_MASK;
+
+    return state ? find_msb_set(state) - 1 : zmk_keymap_layer_default();
 }
 
-// Work queue for deferred layer color updates
-static struct k_work_delayable layer_update_work;
+// displayed layer as recorded by the listener, rendered by layer_update_work
+static atomic_t pending_layer;
+
+// Work queue for deferred layer color updates, so the strip transfer and logging
+// happen outside of the ZMK event dispatch
+static void layer_update_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(layer_update_work, layer_update_work_handler);
 
 static void layer_update_work_handler(struct k_work *work) {
-    if (!initialized) {
-        LOG_INF("Layer work handler called but not initialized yet");
-        return;
-    }
+    uint8_t current_layer = atomic_get(&pending_layer);
 
-    // Get current layer status with potential delay for state stabilization
-    uint8_t current_layer = zmk_keymap_highest_layer_active();
-    
-    LOG_INF("DEFERRED LAYER UPDATE: current highest: %d", current_layer);
-    
-    // Debug: Show all active layers
-    for (int i = 0; i < 8; i++) {
-        if (zmk_keymap_layer_active(i)) {
-            LOG_INF("  Layer %d is ACTIVE", i);
-        }
-    }
-    
-    LOG_INF("Updating LED to layer %d color", current_layer);
+    LOG_DBG("DEFERRED LAYER UPDATE: displayed layer %d, layer state 0x%08x", current_layer,
+            (uint32_t)zmk_keymap_layer_state());
     set_layer_color(current_layer);
 }
 
 static int led_layer_listener_cb(const zmk_event_t *eh) {
     if (!initialized) {
-        LOG_INF("Layer event received but not initialized yet");
         return 0;
     }
-    // Get the layer change event details
-    struct zmk_layer_state_changed *layer_event = as_zmk_layer_state_changed(eh);
-    
-    LOG_INF("LAYER EVENT: Layer %d %s", 
-            layer_event->layer, 
-            layer_event->state ? "ON" : "OFF");
-
-    // Special handling for auto-mouse layer (layer 1)
-    // If no layers are active except base layer, ensure we show layer 0
-    bool any_layer_active = false;
-    for (int i = 1; i < 8; i++) {
-        if (zmk_keymap_layer_active(i)) {
-            any_layer_active = true;
-            break;
-        }
-    }
-    
-    if (!any_layer_active) {
-        uint8_t current_layer = 0;
-        LOG_INF("No non-base layers active, forcing layer 0");
-        LOG_INF("Updating LED to layer %d color", current_layer);
-        set_layer_color(current_layer);
-        return 0;
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    uint32_t start = k_cycle_get_32();
+#endif
+
+    // Only record the new state here; the LED is updated from the work queue, and
+    // only if the color actually changes
+    uint8_t layer = resolve_displayed_layer();
+    uint8_t prev_layer = atomic_set(&pending_layer, layer);
+    if (get_layer_color_index(layer) != get_layer_color_index(prev_layer)) {
+        k_work_reschedule(&layer_update_work, K_NO_WAIT);
     }
-    
-    // Get the current highest layer if we reach here
-    uint8_t current_layer = zmk_keymap_highest_layer_active();
-    LOG_INF("Updating LED to layer %d color", current_layer);
-    set_layer_color(current_layer);
+
+#if IS_ENABLED(CONFIG_INDICATOR_LED_STATS)
+    led_stats.layer_listener_max_cycles =
+        MAX(led_stats.layer_listener_max_cycles, k_cycle_get_32() - start);
+#endif
     return 0;
 }
 
@@ -399,77 +1423,132 @@ ZMK_SUBSCRIPTION(led_layer_listener, zmk_layer_state_changed);
 #endif // IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_LAYER_CHANGE)
 
 
-extern void led_process_thread(void *d0, void *d1, void *d2) {
-    ARG_UNUSED(d0);
-    ARG_UNUSED(d1);
-    ARG_UNUSED(d2);
-    while (true) {
-        // wait until a blink item is received and process it
-        struct blink_item blink;
-        k_msgq_get(&led_msgq, &blink, K_FOREVER);
-        LOG_DBG("Got a blink item from msgq");
-
-        led_do_blink(blink);
-
-        // wait interval before processing another blink sequence
-        k_sleep(K_MSEC(CONFIG_INDICATOR_LED_INTERVAL_MS));
-    }
-}
-
-// define led_process_thread with stack size 1024, start running it 100 ms after boot
-K_THREAD_DEFINE(led_process_tid, 1024, led_process_thread, NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO,
-                0, 100);
+// Boot sequence: a chain of delayable work steps started from SYS_INIT, so no
+// thread (and stack) has to stay around after the one-time indications.
+enum boot_stage {
+    BOOT_BATTERY,
+    BOOT_BLE,
+    BOOT_DONE,
+};
 
-extern void led_init_thread(void *d0, void *d1, void *d2) {
-    ARG_UNUSED(d0);
-    ARG_UNUSED(d1);
-    ARG_UNUSED(d2);
+static enum boot_stage boot_stage;
 
-    // Wait for system to stabilize
-    k_sleep(K_MSEC(500));
+static void boot_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(boot_work, boot_work_handler);
 
+static void boot_work_handler(struct k_work *work) {
+    switch (boot_stage) {
+    case BOOT_BATTERY:
+        boot_stage = BOOT_BLE;
 #if IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING) && \
     IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_BATTERY_ON_BOOT)
-    LOG_INF("Indicating initial battery status");
-    indicate_startup_battery();
-    // Wait between sequences
-    k_sleep(K_MSEC(CONFIG_INDICATOR_LED_INTERVAL_MS * 2));
+        if (!indicate_startup_battery()) {
+            // battery level not known yet, retry this stage shortly
+            boot_stage = BOOT_BATTERY;
+            k_work_schedule(&boot_work, K_MSEC(100));
+            return;
+        }
+        // Wait between sequences
+        k_work_schedule(&boot_work, K_MSEC(CONFIG_INDICATOR_LED_INTERVAL_MS * 2));
+        return;
 #endif // IS_ENABLED(CONFIG_ZMK_BATTERY_REPORTING)
+        __fallthrough;
 
+    case BOOT_BLE:
+        boot_stage = BOOT_DONE;
 #if IS_ENABLED(CONFIG_ZMK_BLE) && IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_BLE)
-    // check and indicate current profile or peripheral connectivity status
-    LOG_INF("Indicating initial connectivity status");
-    indicate_ble();
-    // Wait between sequences
-    k_sleep(K_MSEC(CONFIG_INDICATOR_LED_INTERVAL_MS * 2));
+        // check and indicate current profile or peripheral connectivity status
+        LOG_INF("Indicating initial connectivity status");
+        indicate_ble();
+        // Wait between sequences
+        k_work_schedule(&boot_work, K_MSEC(CONFIG_INDICATOR_LED_INTERVAL_MS * 2));
+        return;
 #endif // IS_ENABLED(CONFIG_ZMK_BLE)
+        __fallthrough;
+
+    case BOOT_DONE:
+    default:
+        break;
+    }
 
     initialized = true;
     LOG_INF("Finished initializing LED widget");
 
 #if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_LAYER_CHANGE)
 #if !IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL)
-    // Initialize the layer update work queue
-    k_work_init_delayable(&layer_update_work, layer_update_work_handler);
     // Set initial layer color including auto-mouse layer
-    uint8_t current_layer = zmk_keymap_highest_layer_active();
-    LOG_INF("INIT: Current highest layer: %d", current_layer);
-    
-    // Debug: Show all active layers at startup
-    for (int i = 0; i < 8; i++) {
-        if (zmk_keymap_layer_active(i)) {
-            LOG_INF("INIT: Layer %d is ACTIVE", i);
-        }
+    atomic_set(&pending_layer, resolve_displayed_layer());
+    LOG_INF("INIT: Current displayed layer: %d", (int)atomic_get(&pending_layer));
+    k_work_reschedule(&layer_update_work, K_NO_WAIT);
+#endif
+#endif
+}
+
+// Activity: the LED goes dark while the keyboard is idle and comes back with the
+// cached frame on the next key press, without querying the keymap or BLE state again
+static void led_quiesce(void);
+
+static int led_activity_listener_cb(const zmk_event_t *eh) {
+    switch (as_zmk_activity_state_changed(eh)->state) {
+    case ZMK_ACTIVITY_ACTIVE:
+        led_render_blank(false);
+        // play what was posted in the meantime
+        k_work_submit(&blink_kick_work);
+        break;
+    case ZMK_ACTIVITY_IDLE:
+        led_render_blank(true);
+        led_blink_cancel();
+        break;
+    case ZMK_ACTIVITY_SLEEP:
+        led_quiesce();
+        break;
     }
-    
-    LOG_INF("Setting initial layer %d color", current_layer);
-    set_layer_color(current_layer);
+    return 0;
+}
+
+ZMK_LISTENER(led_activity_listener, led_activity_listener_cb);
+ZMK_SUBSCRIPTION(led_activity_listener, zmk_activity_state_changed);
+
+// Before deep sleep: leave the strip off (and unpowered, if gated) with no work
+// pending. The sleep transition is raised from the system work queue, which also
+// runs the render owner, so the frame can be committed directly here.
+static void led_quiesce(void) {
+    atomic_set(&render_blanked, 1);
+    k_work_cancel_delayable(&boot_work);
+    k_work_cancel_delayable(&blink_work);
+    k_work_cancel(&blink_kick_work);
+#if IS_ENABLED(CONFIG_INDICATOR_LED_SHOW_LAYER_CHANGE) && \
+    (!IS_ENABLED(CONFIG_ZMK_SPLIT) || IS_ENABLED(CONFIG_ZMK_SPLIT_ROLE_CENTRAL))
+    k_work_cancel_delayable(&layer_update_work);
 #endif
+#if IS_ENABLED(CONFIG_INDICATOR_LED_POWER_GATE)
+    k_work_cancel_delayable(&led_power_settled_work);
 #endif
 
+    // Drop the sequence in flight: if the sleep is aborted, ACTIVE has to find the
+    // engine idle and no stale overlay on the stack
+    blink_state.phase = BLINK_IDLE;
+    blink_state.busy_since_ms = 0;
+    atomic_clear(&blink_cancelled);
+    led_render_clear(RENDER_LAYER_OVERLAY);
+    k_work_cancel(&render_work);
+
+    led_power_release();
+    led_commit_frame(COLOR_OFF);
+#if IS_ENABLED(CONFIG_INDICATOR_LED_SPI_RUNTIME_PM) && DT_ON_BUS(LED_STRIP_NODE_ID, spi)
+    k_work_cancel_delayable(&led_spi_autosuspend_work);
+#endif
+    led_spi_suspend();
+    LOG_DBG("LED quiesced for sleep");
+}
+
+static int led_init(void) {
+    led_spi_pm_init();
+
+    // give the battery sensor and BLE stack a moment before the first indication
+    k_work_schedule(&boot_work, K_MSEC(CONFIG_INDICATOR_LED_BOOT_DELAY_MS));
+    return 0;
 }
 
-// run init thread on boot for initial battery+output checks  
-// Increased delay to ensure system is fully initialized
-K_THREAD_DEFINE(led_init_tid, 1024, led_init_thread, NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO,
-                0, 1000);
+// run the boot sequence for initial battery+output checks
+SYS_INIT(led_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Generate the output brightness curve of the indicator LED.
+
+Writes the 256 entries of a uint8_t lookup table, comma separated, to be
+included into an array initializer. Channel values are mapped either along
+CIE 1976 lightness (L*), so equal steps look equally bright, or along a
+power-law gamma curve.
+"""
+
+import argparse
+import os
+
+
+def cie_lightness(v):
+    # v is the perceived lightness L* / 100, returns the relative luminance Y
+    lightness = v * 100
+    if lightness > 8:
+        return ((lightness + 16) / 116) ** 3
+    return lightness / 903.3
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--curve", choices=("cie", "gamma"), required=True)
+    parser.add_argument("--gamma-x100", type=int, default=220,
+                        help="gamma exponent times 100, for --curve gamma")
+    parser.add_argument("--output", required=True)
+    args = parser.parse_args()
+
+    if args.curve == "cie":
+        curve = cie_lightness
+    else:
+        gamma = args.gamma_x100 / 100
+
+        def curve(v):
+            return v ** gamma
+
+    lut = [round(curve(i / 255) * 255) for i in range(256)]
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("/* Generated by gen_output_lut.py, do not edit */\n")
+        for row in range(0, 256, 16):
+            f.write(" ".join(f"{v:3d}," for v in lut[row:row + 16]) + "\n")
+
+
+if __name__ == "__main__":
+    main()
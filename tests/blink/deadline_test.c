@@ -0,0 +1,138 @@
+/*
+ * Host test of the blink engine deadlines in indicator_led_deadline.h: with
+ * wakeups injected late, every step must stay due at the sequence start plus the
+ * delays before it, so latency never drifts the sequence, and a stall longer than
+ * a step must be caught up rather than pushed onto the rest of the sequence.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "indicator_led_deadline.h"
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            if (failures++ < 20) { \
+                printf(__VA_ARGS__); \
+                printf("\n"); \
+            } \
+        } \
+    } while (0)
+
+#define STEPS 5000
+
+// Delays of a pulse pattern: 100 ms holds, fades in 20 ms frames, a pause between
+// repeats, and an interval between sequences
+static uint32_t step_delay(int step) {
+    static const uint32_t delays[] = {100, 20, 20, 20, 20, 20, 100, 20, 20, 20, 20, 20,
+                                      150, 100, 100, 100, 100, 750};
+
+    return delays[step % (sizeof(delays) / sizeof(delays[0]))];
+}
+
+// xorshift, so the run is the same on every host
+static uint32_t rng_state = 0x1ed5eed;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Wakeup latency of a step: mostly 0-3 ms of work queue contention, sometimes a
+// few ms of BLE or flash activity, rarely a stall longer than several steps
+static uint32_t injected_latency(int step) {
+    uint32_t r = rng() % 1000;
+
+    if (step == 1234) {
+        return 400;
+    }
+    if (r < 5) {
+        return 60 + rng() % 200;
+    }
+    if (r < 100) {
+        return 4 + rng() % 12;
+    }
+    return rng() % 4;
+}
+
+// Runs the steps the way blink_work_handler() schedules them on K_TIMEOUT_ABS_MS
+// deadlines, where a deadline in the past runs at once. A relative scheduler is run
+// alongside with the same latencies for comparison.
+static void test_no_drift(void) {
+    int64_t start_ms = 12345;
+    int64_t deadline_ms = start_ms;
+    int64_t due_ms = start_ms;
+    int64_t now_ms = start_ms;
+    int64_t relative_ms = start_ms;
+    uint64_t latency_total = 0;
+    uint32_t late_max = 0;
+    uint32_t hist[BLINK_LATE_BUCKETS] = {};
+    int catching_up = 0;
+
+    for (int step = 0; step < STEPS; step++) {
+        uint32_t latency = injected_latency(step);
+        uint32_t delay_ms = step_delay(step);
+        int64_t ran_ms = (now_ms > deadline_ms ? now_ms : deadline_ms) + latency;
+        uint32_t late = ran_ms - deadline_ms;
+
+        // late only by this wakeup's latency, plus whatever an earlier stall left
+        CHECK(late == latency || now_ms > deadline_ms,
+              "step %d: %u ms late with %u ms latency", step, late, latency);
+        catching_up += now_ms > deadline_ms;
+        hist[blink_late_bucket(late)]++;
+        late_max = late > late_max ? late : late_max;
+        latency_total += latency;
+
+        now_ms = ran_ms;
+        due_ms += delay_ms;
+        CHECK(blink_deadline_advance(&deadline_ms, delay_ms) == due_ms,
+              "step %d: next deadline %lld, due at %lld", step, (long long)deadline_ms,
+              (long long)due_ms);
+        relative_ms += latency + delay_ms;
+    }
+
+    CHECK(deadline_ms == due_ms, "deadline drifted by %lld ms",
+          (long long)(deadline_ms - due_ms));
+    // the stall has long been caught up, so the last step runs on time
+    CHECK(now_ms <= deadline_ms, "still %lld ms behind at the end",
+          (long long)(now_ms - deadline_ms));
+
+    printf("%d steps over %lld ms with %llu ms of injected latency:\n", STEPS,
+           (long long)(due_ms - start_ms), (unsigned long long)latency_total);
+    printf("  absolute deadlines: drift %lld ms, %d steps caught up after stalls, "
+           "%u ms late at most\n",
+           (long long)(deadline_ms - due_ms), catching_up, late_max);
+    printf("  relative delays:    drift %lld ms\n", (long long)(relative_ms - due_ms));
+    printf("  lateness 0/1/2-3/4-7/8-15/16+ ms: %u/%u/%u/%u/%u/%u\n", hist[0], hist[1],
+           hist[2], hist[3], hist[4], hist[5]);
+}
+
+static void test_late_buckets(void) {
+    static const struct {
+        uint32_t late_ms;
+        uint8_t bucket;
+    } cases[] = {
+        {0, 0}, {1, 1}, {2, 2}, {3, 2}, {4, 3}, {7, 3}, {8, 4},
+        {15, 4}, {16, 5}, {17, 5}, {1000, 5}, {UINT32_MAX, 5},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        CHECK(blink_late_bucket(cases[i].late_ms) == cases[i].bucket,
+              "%u ms late: bucket %u, want %u", cases[i].late_ms,
+              blink_late_bucket(cases[i].late_ms), cases[i].bucket);
+    }
+}
+
+int main(void) {
+    test_late_buckets();
+    test_no_drift();
+
+    printf("%d failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/*
+ * Host test of the blink engine keyframes in indicator_led_keyframe.h: transitions
+ * must last exactly their duration and end exactly on their target, and the
+ * engine must wake up less often than a fixed-rate frame loop would.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct led_rgb {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+#include "indicator_led_keyframe.h"
+
+// CONFIG_INDICATOR_LED_FRAME_RATE default
+#define FRAME_MS (1000 / 50)
+
+static int failures;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            if (failures++ < 20) { \
+                printf(__VA_ARGS__); \
+                printf("\n"); \
+            } \
+        } \
+    } while (0)
+
+struct run {
+    uint32_t duration_ms;   // time from the start of the step to the target frame
+    uint32_t wakeups;       // frames shown, each one a wakeup of the engine
+    uint32_t slept;         // frames skipped because the output didn't change
+    struct led_rgb last;    // last frame shown
+};
+
+// Plays one hold the way blink_transition() and blink_keyframe_frame() do
+static struct run play(struct led_rgb from, struct led_rgb to, uint16_t duration_ms, uint8_t ease,
+                       uint16_t frame_ms) {
+    struct blink_keyframe kf = {};
+    struct led_rgb shown = from;
+    struct run run = {};
+
+    if (!blink_keyframe_start(&kf, shown, to, duration_ms, ease, frame_ms)) {
+        run.duration_ms = duration_ms;
+        run.wakeups = 1;
+        run.last = to;
+        return run;
+    }
+
+    run.duration_ms = blink_keyframe_advance(&kf, shown, &run.slept);
+    for (;;) {
+        // the last frame ends the hold, so it's due even if the output stays the same
+        CHECK(kf.remaining_ms == 0 || !led_rgb_equal(kf.next, shown),
+              "frame at %u ms doesn't change the output", run.duration_ms);
+        shown = kf.next;
+        run.wakeups++;
+        if (kf.remaining_ms == 0) {
+            break;
+        }
+        run.duration_ms += blink_keyframe_advance(&kf, shown, &run.slept);
+    }
+    run.last = shown;
+    return run;
+}
+
+// wakeups of a loop that renders every frame until the hold ends
+static uint32_t fixed_rate_wakeups(uint16_t duration_ms, uint16_t frame_ms) {
+    return (duration_ms + frame_ms - 1) / frame_ms;
+}
+
+static const struct led_rgb colors[] = {
+    {0, 0, 0}, {255, 255, 255}, {255, 0, 0}, {0, 255, 0}, {0, 0, 255},
+    {255, 255, 0}, {8, 0, 16}, {1, 2, 3}, {128, 64, 32},
+};
+
+#define COLOR_COUNT (sizeof(colors) / sizeof(colors[0]))
+
+// Every hold duration (10 ms to 1910 ms) between every pair of test colors, along
+// every curve and at a few frame rates: exact duration, exact target
+static void test_holds_exact(void) {
+    static const uint16_t frame_periods[] = {FRAME_MS, 10, 33, 50};
+
+    for (size_t f = 0; f < sizeof(frame_periods) / sizeof(frame_periods[0]); f++) {
+        for (uint8_t ease = EASE_STEP; ease < EASE_COUNT; ease++) {
+            for (uint16_t duration_ms = 10; duration_ms <= 1910; duration_ms += 10) {
+                for (size_t i = 0; i < COLOR_COUNT; i++) {
+                    for (size_t j = 0; j < COLOR_COUNT; j++) {
+                        struct run run = play(colors[i], colors[j], duration_ms, ease,
+                                              frame_periods[f]);
+
+                        CHECK(run.duration_ms == duration_ms,
+                              "ease %u, %u ms at %u ms frames: lasted %u ms", ease, duration_ms,
+                              frame_periods[f], run.duration_ms);
+                        CHECK(led_rgb_equal(run.last, colors[j]),
+                              "ease %u, %u ms: ended on (%u,%u,%u), want (%u,%u,%u)", ease,
+                              duration_ms, run.last.r, run.last.g, run.last.b, colors[j].r,
+                              colors[j].g, colors[j].b);
+                        CHECK(run.wakeups <= fixed_rate_wakeups(duration_ms, frame_periods[f]),
+                              "ease %u, %u ms: %u wakeups, more than a fixed-rate loop", ease,
+                              duration_ms, run.wakeups);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// A breathing fade, as in the pulse pattern: wakeups against a 50 Hz loop
+static void test_breathing_wakeups(void) {
+    static const struct {
+        struct led_rgb color;
+        const char *name;
+    } cases[] = {
+        {{255, 255, 255}, "white"},
+        {{0, 0, 255}, "blue"},
+        {{0, 0, 24}, "dim blue"},
+    };
+    uint32_t fixed = 2 * fixed_rate_wakeups(450, FRAME_MS);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        struct led_rgb off = {0, 0, 0};
+        struct run in = play(off, cases[i].color, 450, EASE_IN_OUT, FRAME_MS);
+        struct run out = play(cases[i].color, off, 450, EASE_IN_OUT, FRAME_MS);
+        uint32_t wakeups = in.wakeups + out.wakeups;
+
+        printf("breathing %-8s 2 x 450 ms ease-in-out: %2u wakeups, %2u frames slept, "
+               "50 Hz loop %u wakeups\n",
+               cases[i].name, wakeups, in.slept + out.slept, fixed);
+        CHECK(wakeups + in.slept + out.slept == fixed,
+              "%s: wakeups and slept frames don't add up to the frame count", cases[i].name);
+        CHECK(wakeups <= fixed, "%s: more wakeups than a 50 Hz loop", cases[i].name);
+    }
+}
+
+// The eased progress is monotonic and the curves end where they should
+static void test_ease_luts(void) {
+    for (uint8_t ease = EASE_LINEAR; ease < EASE_COUNT; ease++) {
+        CHECK(ease_lut[ease][0] == 0 && ease_lut[ease][EASE_LUT_SEGMENTS] == 255,
+              "ease %u doesn't run from 0 to 255", ease);
+        for (int i = 1; i <= EASE_LUT_SEGMENTS; i++) {
+            CHECK(ease_lut[ease][i] >= ease_lut[ease][i - 1], "ease %u decreases at %d", ease, i);
+        }
+    }
+}
+
+int main(void) {
+    test_ease_luts();
+    test_holds_exact();
+    test_breathing_wakeups();
+
+    printf("%d failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
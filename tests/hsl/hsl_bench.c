@@ -0,0 +1,69 @@
+/*
+ * Host timing of the fixed-point hsl_to_rgb() against the float reference it
+ * replaced, over the whole (h, s, l) space. Host CPUs have a hardware FPU, so
+ * this understates the gap on an FPU-less MCU where floats go through libgcc.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+struct led_rgb {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+#include "indicator_led_hsl.h"
+
+#define ROUNDS 20
+#define CONVERSIONS ((uint64_t)ROUNDS * 360 * 101 * 101)
+
+// kept out of line so that both paths pay the same call overhead
+__attribute__((noinline)) static struct led_rgb hsl_fixed(int h, int s, int l) {
+    return hsl_to_rgb(h, s, l);
+}
+
+__attribute__((noinline)) static struct led_rgb hsl_float(int h, int s, int l) {
+    struct led_rgb rgb = {
+        .r = HSL_REF_R(h, s, l),
+        .g = HSL_REF_G(h, s, l),
+        .b = HSL_REF_B(h, s, l),
+    };
+    return rgb;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double time_ns(struct led_rgb (*convert)(int, int, int), uint32_t *sum) {
+    double start = now_ns();
+
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int h = 0; h < 360; h++) {
+            for (int s = 0; s <= 100; s++) {
+                for (int l = 0; l <= 100; l++) {
+                    struct led_rgb rgb = convert(h, s, l);
+
+                    *sum += rgb.r + rgb.g + rgb.b;
+                }
+            }
+        }
+    }
+    return (now_ns() - start) / CONVERSIONS;
+}
+
+int main(void) {
+    uint32_t sum_fixed = 0, sum_float = 0;
+    double fixed_ns = time_ns(hsl_fixed, &sum_fixed);
+    double float_ns = time_ns(hsl_float, &sum_float);
+
+    printf("fixed point: %.2f ns per conversion (checksum %u)\n", fixed_ns, sum_fixed);
+    printf("float:       %.2f ns per conversion (checksum %u)\n", float_ns, sum_float);
+    printf("speedup:     %.2fx\n", float_ns / fixed_ns);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Host test of the indicator LED HSL conversion: compares the fixed-point
+ * hsl_to_rgb() and HSL_R/G/B macros against the float reference over the whole
+ * (h, s, l) space. Needs only a C compiler, see CMakeLists.txt.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct led_rgb {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+#include "indicator_led_hsl.h"
+
+#define MAX_ERROR_LSB 1
+#define MAX_OF(a, b) ((a) > (b) ? (a) : (b))
+
+static int failures;
+
+static void check(int h, int s, int l, const char *what, int got, int want, int tolerance) {
+    if (abs(got - want) > tolerance) {
+        if (failures++ < 20) {
+            printf("hsl(%d, %d, %d) %s: got %d, want %d\n", h, s, l, what, got, want);
+        }
+    }
+}
+
+int main(void) {
+    int worst = 0;
+
+    for (int h = 0; h < 360; h++) {
+        for (int s = 0; s <= 100; s++) {
+            for (int l = 0; l <= 100; l++) {
+                struct led_rgb rgb = hsl_to_rgb(h, s, l);
+
+                // the build-time macros and the runtime function must agree exactly
+                check(h, s, l, "HSL_R", HSL_R(h, s, l), rgb.r, 0);
+                check(h, s, l, "HSL_G", HSL_G(h, s, l), rgb.g, 0);
+                check(h, s, l, "HSL_B", HSL_B(h, s, l), rgb.b, 0);
+
+                check(h, s, l, "r", rgb.r, HSL_REF_R(h, s, l), MAX_ERROR_LSB);
+                check(h, s, l, "g", rgb.g, HSL_REF_G(h, s, l), MAX_ERROR_LSB);
+                check(h, s, l, "b", rgb.b, HSL_REF_B(h, s, l), MAX_ERROR_LSB);
+
+                worst = MAX_OF(worst, abs(rgb.r - HSL_REF_R(h, s, l)));
+                worst = MAX_OF(worst, abs(rgb.g - HSL_REF_G(h, s, l)));
+                worst = MAX_OF(worst, abs(rgb.b - HSL_REF_B(h, s, l)));
+
+                // the hue wraps around in both directions
+                struct led_rgb below = hsl_to_rgb(h - 360, s, l);
+                struct led_rgb above = hsl_to_rgb(h + 360, s, l);
+
+                check(h, s, l, "wrap below", below.r << 16 | below.g << 8 | below.b,
+                      rgb.r << 16 | rgb.g << 8 | rgb.b, 0);
+                check(h, s, l, "wrap above", above.r << 16 | above.g << 8 | above.b,
+                      rgb.r << 16 | rgb.g << 8 | rgb.b, 0);
+            }
+        }
+    }
+
+    printf("worst deviation from the float reference: %d LSB, %d failures\n", worst, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}